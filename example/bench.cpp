@@ -0,0 +1,368 @@
+/*
+ * @Description: json2 的基准测试
+ * @FilePath: \json2\example\bench.cpp
+ *
+ *  编译（与其他 example 一样是单个文件，value.cpp 直接 include 进来）：
+ *    g++ -std=c++17 -O2 -DNDEBUG bench.cpp -o bench -lpthread
+ *
+ *  用法：
+ *    bench [-n 次数] [file.json ...]
+ *
+ *  不带文件时，使用内置的、以固定种子生成的语料（每次运行完全相同，便于对比）：
+ *    numeric  类似 canada.json：大量嵌套的坐标数组，以浮点数为主
+ *    strings  类似 twitter.json：object 数组，string 中含有转义字符和非 ASCII 字符
+ *    nested   深层嵌套的 array / object
+ *    ndjson   每行一个 object 的 NDJSON
+ *  也可以传入 canada.json、twitter.json 等真实的文件，对每个文件进行同样的测试。
+ *
+ *  每个语料分别测试：
+ *    parse->null     reader 解析，handler 不做任何事（只衡量 reader 本身）
+ *    parse->dom      document::parse()
+ *    dom->string     value::write_to(writer)
+ *    parse->write    reader 直接驱动 writer（minify）
+ *  其中 parse 类的测试对 memory_read_stream、string_read_stream 和 file_read_stream 分别进行，
+ *  stream 在计时之外构造，构造本身（拷贝 string、读取文件）的耗时单独作为 "stream setup" 一项。
+ *  writer 的输出在预热时会被重新解析，并与原始输入比较，不一致时该项输出 failed。
+ *  每项输出吞吐量（按中位数计算的 MB/s）、每次的耗时分位数（p50 / p90 / p99）以及每次的内存分配次数。
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include "../src/reader.h"
+#include "../src/writer.h"
+#include "../src/document.h"
+#include "../src/ndjson.h"
+#include "../src/read_stream.h"
+#include "../src/write_stream.h"
+#include "../src/value.cpp"
+
+using namespace json2;
+
+// 通过替换全局的 operator new 统计内存分配的次数
+static std::atomic<size_t> g_allocations(0);
+
+void* operator new(size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  if(void* ptr = malloc(size == 0 ? 1 : size))
+    return ptr;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  free(ptr);
+}
+
+// 接收所有事件但什么也不做的 handler
+struct null_handler {
+  bool handle_null() { return true; }
+  bool handle_bool(bool) { return true; }
+  bool handle_int32(int32_t) { return true; }
+  bool handle_int64(int64_t) { return true; }
+  bool handle_double(double) { return true; }
+  bool handle_string(const std::string&) { return true; }
+  bool handle_key(const std::string&) { return true; }
+  bool handle_start_object() { return true; }
+  bool handle_end_object() { return true; }
+  bool handle_start_array() { return true; }
+  bool handle_end_array() { return true; }
+};
+
+struct corpus {
+  std::string name_;
+  std::string data_;
+  bool ndjson_;
+};
+
+// 以下为生成内置语料的函数，使用固定的种子
+static std::string make_numeric(std::mt19937_64& rng) {
+  std::uniform_real_distribution<double> lon(-141.0, -52.0), lat(41.0, 83.0);
+  std::string out = "{\"type\":\"FeatureCollection\",\"features\":[";
+  char buf[64];
+  for(int f = 0; f < 4; f++) {
+    out += f ? "," : "";
+    out += "{\"type\":\"Feature\",\"properties\":{\"name\":\"Canada\"},"
+           "\"geometry\":{\"type\":\"Polygon\",\"coordinates\":[";
+    for(int ring = 0; ring < 120; ring++) {
+      out += ring ? ",[" : "[";
+      for(int p = 0; p < 100; p++) {
+        snprintf(buf, sizeof(buf), "%s[%.14f,%.14f]", p ? "," : "", lon(rng), lat(rng));
+        out += buf;
+      }
+      out += "]";
+    }
+    out += "]}}";
+  }
+  out += "]}";
+  return out;
+}
+
+static std::string make_strings(std::mt19937_64& rng) {
+  static const char* words[] = {
+    "hello", "world", "json", "\\u3053\\u3093\\u306b\\u3061\\u306f", "caf\xc3\xa9",
+    "\xe4\xbd\xa0\xe5\xa5\xbd", "\\\"quoted\\\"", "line\\nbreak", "tab\\there", "\\ud83d\\ude00",
+    "RT", "@user", "#tag", "https:\\/\\/t.co\\/abc"
+  };
+  std::uniform_int_distribution<int> word(0, sizeof(words) / sizeof(words[0]) - 1);
+  std::uniform_int_distribution<int64_t> id(100000000000000000LL, 999999999999999999LL);
+  std::string out = "{\"statuses\":[";
+  for(int i = 0; i < 3000; i++) {
+    out += i ? "," : "";
+    out += "{\"id\":" + std::to_string(id(rng)) + ",\"text\":\"";
+    for(int w = 0; w < 20; w++) {
+      out += w ? " " : "";
+      out += words[word(rng)];
+    }
+    out += "\",\"user\":{\"name\":\"";
+    out += words[word(rng)];
+    out += "\",\"followers_count\":" + std::to_string(i * 7 % 10007) +
+           ",\"verified\":" + (i % 3 ? "false" : "true") +
+           "},\"retweet_count\":" + std::to_string(i % 97) +
+           ",\"in_reply_to\":null,\"lang\":\"ja\"}";
+  }
+  out += "]}";
+  return out;
+}
+
+static std::string make_nested() {
+  std::string out;
+  for(int i = 0; i < 2000; i++) {
+    out += i ? ",[" : "[";
+    for(int depth = 0; depth < 500; depth++)
+      out += depth % 2 ? "[" : "{\"k\":";
+    out += "1";
+    for(int depth = 499; depth >= 0; depth--)
+      out += depth % 2 ? "]" : "}";
+    out += "]";
+  }
+  return "[" + out + "]";
+}
+
+static std::string make_ndjson(std::mt19937_64& rng) {
+  std::uniform_int_distribution<int> val(0, 1000000);
+  std::string out;
+  for(int i = 0; i < 50000; i++) {
+    out += "{\"ts\":" + std::to_string(1600000000 + i) + ",\"level\":\"" +
+           (i % 10 ? "info" : "error") + "\",\"latency\":" + std::to_string(val(rng) / 1000.0) +
+           ",\"tags\":[\"a\",\"b\"],\"ok\":true}\n";
+  }
+  return out;
+}
+
+// 多次执行 fn，输出耗时分位数、吞吐量以及每次的内存分配次数。
+// setup 不为空时，每次执行 fn 之前先执行 setup（如构造 stream），其耗时和内存分配不计入结果；
+// check 不为空时，预热时以 check 代替 fn，用于检查结果是否正确（如 writer 的输出能否还原为原来的 json）
+static void run(const char* corpus_name, const char* test_name, size_t bytes, int iterations,
+                const std::function<bool()>& fn, const std::function<void()>& setup = nullptr,
+                const std::function<bool()>& check = nullptr) {
+  std::vector<double> seconds;
+  size_t allocations = 0;
+  if(setup)
+    setup();
+  if(!(check ? check() : fn())) {
+    printf("%-10s %-24s failed\n", corpus_name, test_name);
+    return;
+  }
+  for(int i = 0; i < iterations; i++) {
+    if(setup)
+      setup();
+    size_t before = g_allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    allocations += g_allocations.load() - before;
+    seconds.push_back(std::chrono::duration<double>(end - start).count());
+  }
+  std::sort(seconds.begin(), seconds.end());
+  auto percentile = [&](double p) {
+    return seconds[std::min(seconds.size() - 1, static_cast<size_t>(p * seconds.size()))] * 1e3;
+  };
+  printf("%-10s %-24s %9.1f MB/s   p50 %8.3f ms  p90 %8.3f ms  p99 %8.3f ms  %10zu allocs\n",
+         corpus_name, test_name, bytes / percentile(0.5) / 1e3, percentile(0.5),
+         percentile(0.9), percentile(0.99), allocations / iterations);
+}
+
+// 将 json 解析之后再以 writer 输出，用于比较两个 json 是否相同（不受空白字符、转义方式等的影响）
+static bool normalize(const std::string& json, std::string& out) {
+  document doc;
+  memory_read_stream in(json.data(), json.data() + json.size());
+  if(doc.parse(in) != PARSE_OK)
+    return false;
+  string_write_stream stream;
+  writer<string_write_stream> handler(stream);
+  if(!doc.write_to(handler))
+    return false;
+  out = stream.get();
+  return true;
+}
+
+// writer 的输出 output 必须是合法的 json，且与原始输入 input 相同
+static bool same_json(const std::string& input, const std::string& output) {
+  std::string lhs, rhs;
+  return normalize(input, lhs) && normalize(output, rhs) && lhs == rhs;
+}
+
+// 将 data 写入一个临时文件，用于测试 file_read_stream
+static FILE* make_temp_file(const std::string& data) {
+  FILE* fp = tmpfile();
+  if(fp != nullptr) {
+    fwrite(data.data(), 1, data.size(), fp);
+    fflush(fp);
+  }
+  return fp;
+}
+
+// stream 在计时之外构造（构造本身的耗时见 "stream setup" 一项）
+template <typename MakeStream>
+static void run_parse(const corpus& c, const char* stream_name, int iterations,
+                      MakeStream make_stream) {
+  decltype(make_stream()) stream;
+  auto setup = [&] { stream = make_stream(); };
+  char name[64];
+  snprintf(name, sizeof(name), "stream setup (%s)", stream_name);
+  run(c.name_.c_str(), name, c.data_.size(), iterations, [&] {
+    stream = make_stream();
+    return stream != nullptr;
+  });
+
+  snprintf(name, sizeof(name), "parse->null (%s)", stream_name);
+  run(c.name_.c_str(), name, c.data_.size(), iterations, [&] {
+    null_handler handler;
+    return reader::parse(*stream, handler) == PARSE_OK;
+  }, setup);
+
+  snprintf(name, sizeof(name), "parse->dom (%s)", stream_name);
+  run(c.name_.c_str(), name, c.data_.size(), iterations, [&] {
+    document doc;
+    return doc.parse(*stream) == PARSE_OK;
+  }, setup);
+
+  snprintf(name, sizeof(name), "parse->write (%s)", stream_name);
+  std::string output;
+  auto write = [&](bool keep) {
+    string_write_stream out;
+    writer<string_write_stream> handler(out);
+    if(reader::parse(*stream, handler) != PARSE_OK)
+      return false;
+    if(keep)
+      output = out.get();
+    return true;
+  };
+  run(c.name_.c_str(), name, c.data_.size(), iterations, [&] {
+    return write(false);
+  }, setup, [&] {
+    return write(true) && same_json(c.data_, output);
+  });
+}
+
+static void run_corpus(const corpus& c, int iterations) {
+  if(c.ndjson_) {
+    ndjson_options options;
+    options.threads = 1;
+    run(c.name_.c_str(), "parse->dom (ndjson 1T)", c.data_.size(), iterations, [&] {
+      return ndjson_reader::parse(c.data_, [](size_t, value&) {}, options) == PARSE_OK;
+    });
+    options.threads = 0;
+    run(c.name_.c_str(), "parse->dom (ndjson MT)", c.data_.size(), iterations, [&] {
+      return ndjson_reader::parse(c.data_, [](size_t, value&) {}, options) == PARSE_OK;
+    });
+    return;
+  }
+
+  run_parse(c, "memory", iterations, [&] {
+    return std::unique_ptr<memory_read_stream>(
+        new memory_read_stream(c.data_.data(), c.data_.data() + c.data_.size()));
+  });
+
+  run_parse(c, "string", iterations, [&] {
+    return std::unique_ptr<string_read_stream>(new string_read_stream(c.data_));
+  });
+
+  FILE* fp = make_temp_file(c.data_);
+  if(fp != nullptr) {
+    run_parse(c, "file", iterations, [&] {
+      rewind(fp);
+      return std::unique_ptr<file_read_stream>(new file_read_stream(fp));
+    });
+    fclose(fp);
+  }
+
+  document doc;
+  memory_read_stream in(c.data_.data(), c.data_.data() + c.data_.size());
+  if(doc.parse(in) != PARSE_OK)
+    return;
+  std::string output;
+  auto write = [&](bool keep) {
+    string_write_stream out;
+    writer<string_write_stream> handler(out);
+    if(!doc.write_to(handler))
+      return false;
+    if(keep)
+      output = out.get();
+    return true;
+  };
+  run(c.name_.c_str(), "dom->string", c.data_.size(), iterations, [&] {
+    return write(false);
+  }, nullptr, [&] {
+    return write(true) && same_json(c.data_, output);
+  });
+}
+
+static bool read_file(const char* path, std::string& data) {
+  FILE* fp = fopen(path, "rb");
+  if(fp == nullptr)
+    return false;
+  char buffer[65536];
+  size_t count;
+  while((count = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+    data.append(buffer, count);
+  fclose(fp);
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  int iterations = 20;
+  std::vector<corpus> corpora;
+  for(int i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      iterations = std::max(1, atoi(argv[++i]));
+      continue;
+    }
+    corpus c{argv[i], "", false};
+    if(!read_file(argv[i], c.data_)) {
+      printf("failed to open file %s\n", argv[i]);
+      return 1;
+    }
+    // 以 .ndjson / .jsonl 结尾的文件按 NDJSON 测试
+    size_t dot = c.name_.rfind('.');
+    std::string ext = dot == std::string::npos ? "" : c.name_.substr(dot);
+    c.ndjson_ = ext == ".ndjson" || ext == ".jsonl";
+    corpora.push_back(std::move(c));
+  }
+
+  if(corpora.empty()) {
+    std::mt19937_64 rng(20191208);
+    corpora.push_back({"numeric", make_numeric(rng), false});
+    corpora.push_back({"strings", make_strings(rng), false});
+    corpora.push_back({"nested", make_nested(), false});
+    corpora.push_back({"ndjson", make_ndjson(rng), true});
+  }
+
+  for(const auto& c : corpora) {
+    printf("== %s: %.2f MB\n", c.name_.c_str(), c.data_.size() / 1e6);
+    run_corpus(c, iterations);
+  }
+  return 0;
+}
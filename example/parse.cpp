@@ -15,10 +15,11 @@
 
 using namespace json2;
 
-int main() {
+// 用法：parse [file]，不指定 file 时读取当前目录下的 demo.txt
+int main(int argc, char* argv[]) {
     FILE* fp;
-    // TODO:相对路径有问题 
-    if((fp = fopen("C:\\Users\\Magicmanoooo\\Desktop\\json2\\example\\demo.txt", "rb")) == NULL) {
+    const char* path = argc > 1 ? argv[1] : "demo.txt";
+    if((fp = fopen(path, "rb")) == NULL) {
         printf("failed to open file\n");
         exit(0);
     }
@@ -0,0 +1,166 @@
+#ifndef _ASYNC_WRITE_STREAM_H_
+#define _ASYNC_WRITE_STREAM_H_
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unistd.h>
+
+namespace json2 {
+
+/*
+ * async_file_write_stream 类：双缓冲的异步文件输出流
+ *      writer 所在线程只向 fill_ 中追加数据，后台线程负责将 flush_ 通过 write(2) 写入 fd_。
+ *      当 fill_ 写满时，两块 buffer 交换；如果此时后台线程还没有写完上一块 buffer，
+ *      writer 所在线程会阻塞等待（backpressure），因此内存占用最多为 2 * buffer_size。
+ *
+ *  e.g.
+ *  ```
+ *    async_file_write_stream out(fd);
+ *    writer<async_file_write_stream> write(out);
+ *    reader::parse(in, write);
+ *    out.flush();
+ *  ```
+ *
+ *  注：fd_ 的所有权不属于该类，析构时只会 flush，不会 close
+ */
+class async_file_write_stream {
+public:
+  async_file_write_stream(const async_file_write_stream&) = delete;
+  async_file_write_stream& operator=(const async_file_write_stream&) = delete;
+
+  // fsync_on_flush 为 true 时，每写完一块 buffer 都会调用一次 fsync()
+  explicit async_file_write_stream(int fd, size_t buffer_size = 1 << 20,
+                                   bool fsync_on_flush = false) :
+    fd_(fd),
+    capacity_(buffer_size > 0 ? buffer_size : 1),
+    fsync_on_flush_(fsync_on_flush),
+    pending_(false),
+    stop_(false),
+    error_(0) {
+    fill_.reserve(capacity_);
+    flush_.reserve(capacity_);
+    thread_ = std::thread([this] { run(); });
+  }
+
+  ~async_file_write_stream() {
+    flush();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cond_.notify_all();
+    thread_.join();
+  }
+
+  void dump(char ch) {
+    if(fill_.size() == capacity_)
+      swap_aux();
+    fill_.push_back(ch);
+  }
+
+  void dump(const char* str) {
+    dump(str, strlen(str));
+  }
+
+  void dump(std::string str) {
+    dump(str.data(), str.size());
+  }
+
+  void dump(const char* str, size_t len) {
+    while(len > 0) {
+      if(fill_.size() == capacity_)
+        swap_aux();
+      size_t count = std::min(len, capacity_ - fill_.size());
+      fill_.insert(fill_.end(), str, str + count);
+      str += count;
+      len -= count;
+    }
+  }
+
+  // 将已输出的内容全部交给后台线程，并等待其写完
+  void flush() {
+    if(!fill_.empty())
+      swap_aux();
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this] { return !pending_; });
+  }
+
+  // 返回后台写入时遇到的第一个错误（errno），0 表示没有错误
+  int error() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return error_;
+  }
+
+private:
+  // 等待后台线程空闲，然后交换两块 buffer，并通知后台线程开始写
+  void swap_aux() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this] { return !pending_; });
+    std::swap(fill_, flush_);
+    pending_ = true;
+    lock.unlock();
+    cond_.notify_all();
+  }
+
+  void run() {
+    while(true) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [this] { return pending_ || stop_; });
+      if(!pending_)
+        return;
+      lock.unlock();
+
+      int err = write_aux(flush_.data(), flush_.size());
+      if(err == 0 && fsync_on_flush_ && fsync(fd_) != 0)
+        err = errno;
+      flush_.clear();
+
+      lock.lock();
+      if(error_ == 0)
+        error_ = err;
+      pending_ = false;
+      lock.unlock();
+      cond_.notify_all();
+    }
+  }
+
+  // write(2) 可能只写入一部分，或者被信号中断，所以需要循环写入
+  int write_aux(const char* data, size_t len) {
+    while(len > 0) {
+      ssize_t count = ::write(fd_, data, len);
+      if(count < 0) {
+        if(errno == EINTR)
+          continue;
+        return errno;
+      }
+      data += count;
+      len -= static_cast<size_t>(count);
+    }
+    return 0;
+  }
+
+private:
+  int fd_;
+  size_t capacity_;
+  bool fsync_on_flush_;
+
+  std::vector<char> fill_;  // writer 所在线程正在写入的 buffer
+  std::vector<char> flush_; // 后台线程正在写入文件的 buffer
+
+  mutable std::mutex mutex_;
+  std::condition_variable cond_;
+  bool pending_; // 为 true 表示 flush_ 中的数据还没有写完
+  bool stop_;
+  int error_;
+  std::thread thread_;
+};
+
+}
+
+#endif
@@ -0,0 +1,537 @@
+#ifndef _BINARY_H_
+#define _BINARY_H_
+
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+#include "exception.h"
+#include "value.h"
+#include "reader.h"
+
+namespace json2 {
+
+/**
+ * @description: 二进制编码采用 CBOR（RFC 8949）格式，主要用于服务之间传递 json，
+ *      省去了“序列化为文本 -> 再解析文本”的开销：
+ *  ```
+ *    string_write_stream out;
+ *    binary_writer<string_write_stream> w(out);
+ *    doc.write_to(w);                             // value -> CBOR
+ *
+ *    memory_read_stream in(data, data + size);
+ *    binary_reader::parse(in, doc);               // CBOR -> 任意 handler（document、writer 等）
+ *  ```
+ *  每个数据项以 1 个字节的头部开始：高 3 位为 major type，低 5 位为附加信息（长度或数值）
+ *    0: 非负整数    1: 负整数（-1 - n）   2: 字节串   3: UTF-8 string
+ *    4: array       5: object（map）       6: tag      7: false / true / null / 浮点数
+ *  string、array 和 object 都带有长度前缀，因此解码时既不需要转义，也不需要扫描分隔符，
+ *  跳过一个 value 也只需要按长度前移。
+ */
+enum binary_major {
+  BINARY_UNSIGNED = 0,
+  BINARY_NEGATIVE = 1,
+  BINARY_BYTES = 2,
+  BINARY_STRING = 3,
+  BINARY_ARRAY = 4,
+  BINARY_OBJECT = 5,
+  BINARY_TAG = 6,
+  BINARY_SIMPLE = 7,
+};
+
+/**
+ * @description: binary_writer 是一个 handler，将接收到的事件编码为 CBOR 输出至 WriteStream
+ *
+ *  由于 handle_start_array() / handle_start_object() 时还不知道元素的个数，array 和 object
+ *  的头部固定使用 4 字节的长度，先占位，在 handle_end_*() 时再回填。
+ *  因此每个 root 先编码到 buffer_ 中，root 结束时才一次性输出到 stream_。
+ *  整数和 string 的长度都使用最短的编码；double 在不损失精度时使用 4 字节的 float 编码。
+ */
+template <typename WriteStream>
+class binary_writer {
+public:
+  binary_writer(const binary_writer&) = delete;
+  binary_writer& operator=(const binary_writer&) = delete;
+
+  explicit binary_writer(WriteStream& stream) :
+    stream_(stream) {}
+
+  bool handle_null() {
+    buffer_.push_back(static_cast<char>(0xf6));
+    return end_value_aux();
+  }
+
+  bool handle_bool(bool val) {
+    buffer_.push_back(static_cast<char>(val ? 0xf5 : 0xf4));
+    return end_value_aux();
+  }
+
+  bool handle_int32(int32_t val) {
+    put_int_aux(val);
+    return end_value_aux();
+  }
+
+  bool handle_int64(int64_t val) {
+    put_int_aux(val);
+    return end_value_aux();
+  }
+
+  bool handle_uint64(uint64_t val) {
+    put_head_aux(BINARY_UNSIGNED, val);
+    return end_value_aux();
+  }
+
+  bool handle_double(double val) {
+    put_double_aux(val);
+    return end_value_aux();
+  }
+
+  bool handle_string(const std::string& str) {
+    put_head_aux(BINARY_STRING, str.size());
+    buffer_.append(str);
+    return end_value_aux();
+  }
+
+  bool handle_key(const std::string& key) {
+    put_head_aux(BINARY_STRING, key.size());
+    buffer_.append(key);
+    return true;
+  }
+
+  // 紧凑数组的元素个数是已知的（见 value::write_to()），直接使用最短的长度编码
+  bool handle_int64_array(const int64_t* vals, size_t size) {
+    put_head_aux(BINARY_ARRAY, size);
+    for(size_t i = 0; i < size; i++)
+      put_int_aux(vals[i]);
+    return end_value_aux();
+  }
+
+  bool handle_double_array(const double* vals, size_t size) {
+    put_head_aux(BINARY_ARRAY, size);
+    for(size_t i = 0; i < size; i++)
+      put_double_aux(vals[i]);
+    return end_value_aux();
+  }
+
+  bool handle_start_object() {
+    return start_container_aux(BINARY_OBJECT);
+  }
+
+  bool handle_end_object() {
+    return end_container_aux();
+  }
+
+  bool handle_start_array() {
+    return start_container_aux(BINARY_ARRAY);
+  }
+
+  bool handle_end_array() {
+    return end_container_aux();
+  }
+
+private:
+  // frame 记录一个未结束的 array 或 object：头部在 buffer_ 中的位置以及已有的成员个数
+  struct frame {
+  public:
+    frame(size_t offset) :
+      offset_(offset),
+      count_(0) {}
+
+  public:
+    size_t offset_;
+    uint32_t count_;
+  };
+
+  // 输出头部：major type 以及 val（长度或整数值）
+  void put_head_aux(binary_major major, uint64_t val) {
+    char head = static_cast<char>(major << 5);
+    if(val < 24) {
+      buffer_.push_back(static_cast<char>(head | val));
+    } else if(val <= 0xff) {
+      buffer_.push_back(static_cast<char>(head | 24));
+      put_bytes_aux(val, 1);
+    } else if(val <= 0xffff) {
+      buffer_.push_back(static_cast<char>(head | 25));
+      put_bytes_aux(val, 2);
+    } else if(val <= 0xffffffff) {
+      buffer_.push_back(static_cast<char>(head | 26));
+      put_bytes_aux(val, 4);
+    } else {
+      buffer_.push_back(static_cast<char>(head | 27));
+      put_bytes_aux(val, 8);
+    }
+  }
+
+  // 以大端序输出 val 的低 count 个字节
+  void put_bytes_aux(uint64_t val, int count) {
+    for(int i = count - 1; i >= 0; i--)
+      buffer_.push_back(static_cast<char>((val >> (i * 8)) & 0xff));
+  }
+
+  void put_int_aux(int64_t val) {
+    if(val >= 0)
+      put_head_aux(BINARY_UNSIGNED, static_cast<uint64_t>(val));
+    else
+      put_head_aux(BINARY_NEGATIVE, static_cast<uint64_t>(-(val + 1)));
+  }
+
+  void put_double_aux(double val) {
+    float single = static_cast<float>(val);
+    if(static_cast<double>(single) == val || std::isnan(val)) {
+      uint32_t bits;
+      memcpy(&bits, &single, sizeof(bits));
+      buffer_.push_back(static_cast<char>(0xfa));
+      put_bytes_aux(bits, 4);
+    } else {
+      uint64_t bits;
+      memcpy(&bits, &val, sizeof(bits));
+      buffer_.push_back(static_cast<char>(0xfb));
+      put_bytes_aux(bits, 8);
+    }
+  }
+
+  bool start_container_aux(binary_major major) {
+    stack_.emplace_back(buffer_.size());
+    buffer_.push_back(static_cast<char>((major << 5) | 26));
+    buffer_.append(4, '\0');
+    return true;
+  }
+
+  bool end_container_aux() {
+    assert(!stack_.empty());
+    auto top = stack_.back();
+    stack_.pop_back();
+    for(int i = 0; i < 4; i++)
+      buffer_[top.offset_ + 1 + i] = static_cast<char>((top.count_ >> ((3 - i) * 8)) & 0xff);
+    return end_value_aux();
+  }
+
+  // 一个 value 结束：递增所在 array / object 的成员个数；若为 root，则输出 buffer_
+  bool end_value_aux() {
+    if(!stack_.empty()) {
+      stack_.back().count_++;
+      return true;
+    }
+    stream_.dump(buffer_.data(), buffer_.size());
+    buffer_.clear();
+    return true;
+  }
+
+private:
+  WriteStream& stream_;
+  std::string buffer_;
+  std::vector<frame> stack_;
+};
+
+/**
+ * @description: binary_reader 解码 CBOR，并像 reader 一样向 handler 发送 handle_*() 事件，
+ *      因此 document、writer 等所有 handler 都可以直接使用。skip_next_value() 同样有效，
+ *      并且被跳过的 value 只需按长度前移，不会产生任何事件。
+ *
+ *  - 整数按其范围发送 handle_int32() 或 handle_int64()，超出 int64_t 范围的正整数发送 handle_uint64()
+ *    （handler 没有实现时发送 handle_double()），超出 int64_t 范围的负整数发送 handle_double()
+ *  - 半精度、单精度和双精度浮点数都发送 handle_double()
+ *  - tag 会被忽略；undefined 视为 null；object 的 key 必须是 string
+ *  - 支持不定长（indefinite-length）的 string、array 和 object
+ *  输入不是合法的 CBOR 时返回 PARSE_BAD_BINARY。
+ */
+class binary_reader {
+public:
+  binary_reader(const binary_reader&) = delete;
+  binary_reader& operator=(const binary_reader&) = delete;
+
+public:
+  template <typename ReadStream, typename Handler>
+  static parse_error parse(ReadStream& stream, Handler& handler) {
+    reader_context ctx;
+    return parse(stream, handler, ctx);
+  }
+
+  template <typename ReadStream, typename Handler>
+  static parse_error parse(ReadStream& stream, Handler& handler, reader_context& ctx) {
+    parse_error err = parse_next(stream, handler, ctx);
+    if(err == PARSE_OK && stream.has_next())
+      return PARSE_ROOT_NOT_SINGULAR;
+    return err;
+  }
+
+  // 只解码 stream 中的下一个 value，解码完成后 stream 停在该 value 之后
+  template <typename ReadStream, typename Handler>
+  static parse_error parse_next(ReadStream& stream, Handler& handler, reader_context& ctx) {
+    try {
+      parse_value_aux(stream, handler, ctx, 0);
+      return PARSE_OK;
+    } catch(json_exception& e) {
+      return e.error();
+    }
+  }
+
+private:
+#define CALL(expr) \
+  if(!(expr)) throw json_exception(PARSE_USER_STOPPED)
+
+  static constexpr uint64_t INDEFINITE = std::numeric_limits<uint64_t>::max();
+
+  template <typename ReadStream>
+  static unsigned char next_aux(ReadStream& stream) {
+    if(!stream.has_next())
+      throw json_exception(PARSE_BAD_BINARY);
+    return static_cast<unsigned char>(stream.next());
+  }
+
+  template <typename ReadStream>
+  static uint64_t read_bytes_aux(ReadStream& stream, int count) {
+    uint64_t val = 0;
+    for(int i = 0; i < count; i++)
+      val = (val << 8) | next_aux(stream);
+    return val;
+  }
+
+  // 读取头部的附加信息 info 所表示的长度或整数值，不定长时返回 INDEFINITE
+  template <typename ReadStream>
+  static uint64_t read_argument_aux(ReadStream& stream, unsigned info) {
+    switch(info) {
+      case 0 ... 23:
+        return info;
+      case 24:
+        return read_bytes_aux(stream, 1);
+      case 25:
+        return read_bytes_aux(stream, 2);
+      case 26:
+        return read_bytes_aux(stream, 4);
+      case 27:
+        return read_bytes_aux(stream, 8);
+      case 31:
+        return INDEFINITE;
+      default:
+        throw json_exception(PARSE_BAD_BINARY);
+    }
+  }
+
+  // 检查下一个字节是否为不定长 array / object / string 的结束标记 0xff
+  template <typename ReadStream>
+  static bool is_break_aux(ReadStream& stream) {
+    if(!stream.has_next())
+      throw json_exception(PARSE_BAD_BINARY);
+    if(static_cast<unsigned char>(stream.peek()) != 0xff)
+      return false;
+    stream.next();
+    return true;
+  }
+
+  // 将一个 string（可以是不定长的，即由多个定长的 string 拼接而成）读入 buffer 中
+  template <typename ReadStream>
+  static void read_string_aux(ReadStream& stream, uint64_t length, std::string& buffer) {
+    if(length == INDEFINITE) {
+      while(!is_break_aux(stream)) {
+        unsigned char head = next_aux(stream);
+        uint64_t chunk = read_argument_aux(stream, head & 0x1f);
+        if((head >> 5) != BINARY_STRING || chunk == INDEFINITE)
+          throw json_exception(PARSE_BAD_BINARY);
+        read_string_aux(stream, chunk, buffer);
+      }
+      return;
+    }
+    for(uint64_t i = 0; i < length; i++)
+      buffer.push_back(static_cast<char>(next_aux(stream)));
+  }
+
+  static double decode_half_aux(unsigned half) {
+    int exponent = (half >> 10) & 0x1f;
+    unsigned mantissa = half & 0x3ff;
+    double val;
+    if(exponent == 0)
+      val = std::ldexp(mantissa, -24);
+    else if(exponent != 31)
+      val = std::ldexp(mantissa + 1024, exponent - 25);
+    else
+      val = mantissa == 0 ? INFINITY : NAN;
+    return (half & 0x8000) ? -val : val;
+  }
+
+  template <typename Handler>
+  static void handle_integer_aux(Handler& handler, uint64_t val, bool negative) {
+    if(val > static_cast<uint64_t>(std::numeric_limits<int64_t>::max())) {
+      if(!negative) {
+        CALL(dispatch_uint64(handler, val));
+        return;
+      }
+      double dval = static_cast<double>(val);
+      CALL(handler.handle_double(negative ? -1.0 - dval : dval));
+      return;
+    }
+    int64_t ival = negative ? -1 - static_cast<int64_t>(val) : static_cast<int64_t>(val);
+    if(ival >= std::numeric_limits<int32_t>::min() && ival <= std::numeric_limits<int32_t>::max()) {
+      CALL(handler.handle_int32(static_cast<int32_t>(ival)));
+    } else {
+      CALL(handler.handle_int64(ival));
+    }
+  }
+
+  // depth 为当前 value 所在的嵌套层数（array、object 和 tag），超过 ctx.max_depth_ 时
+  // 抛出 PARSE_DEPTH_EXCEEDED，避免恶意构造的深层嵌套输入导致栈溢出
+  template <typename ReadStream, typename Handler>
+  static void parse_value_aux(ReadStream& stream, Handler& handler, reader_context& ctx,
+                              size_t depth) {
+    unsigned char head = next_aux(stream);
+    unsigned info = head & 0x1f;
+    if((head >> 5) >= BINARY_ARRAY && (head >> 5) <= BINARY_TAG && depth >= ctx.max_depth_)
+      throw json_exception(PARSE_DEPTH_EXCEEDED);
+    switch(head >> 5) {
+      case BINARY_UNSIGNED:
+      case BINARY_NEGATIVE: {
+        if(info == 31)
+          throw json_exception(PARSE_BAD_BINARY);
+        handle_integer_aux(handler, read_argument_aux(stream, info), (head >> 5) == BINARY_NEGATIVE);
+        return;
+      }
+      case BINARY_STRING:
+        ctx.string_buffer_.clear();
+        read_string_aux(stream, read_argument_aux(stream, info), ctx.string_buffer_);
+        CALL(handler.handle_string(ctx.string_buffer_));
+        return;
+      case BINARY_ARRAY:
+        parse_array_aux(stream, handler, ctx, read_argument_aux(stream, info), depth + 1);
+        return;
+      case BINARY_OBJECT:
+        parse_object_aux(stream, handler, ctx, read_argument_aux(stream, info), depth + 1);
+        return;
+      case BINARY_TAG:
+        read_argument_aux(stream, info);
+        parse_value_aux(stream, handler, ctx, depth + 1);
+        return;
+      case BINARY_SIMPLE:
+        switch(info) {
+          case 20:
+          case 21:
+            CALL(handler.handle_bool(info == 21));
+            return;
+          case 22:
+          case 23:
+            CALL(handler.handle_null());
+            return;
+          case 25:
+            CALL(handler.handle_double(decode_half_aux(static_cast<unsigned>(read_bytes_aux(stream, 2)))));
+            return;
+          case 26: {
+            uint32_t bits = static_cast<uint32_t>(read_bytes_aux(stream, 4));
+            float val;
+            memcpy(&val, &bits, sizeof(val));
+            CALL(handler.handle_double(val));
+            return;
+          }
+          case 27: {
+            uint64_t bits = read_bytes_aux(stream, 8);
+            double val;
+            memcpy(&val, &bits, sizeof(val));
+            CALL(handler.handle_double(val));
+            return;
+          }
+          default:
+            throw json_exception(PARSE_BAD_BINARY);
+        }
+      default:
+        // 字节串在 json 中没有对应的类型
+        throw json_exception(PARSE_BAD_BINARY);
+    }
+  }
+
+  // 解码 array 的元素或 object 的 value，handler 可以通过 skip_next_value() 跳过它
+  template <typename ReadStream, typename Handler>
+  static void parse_member_aux(ReadStream& stream, Handler& handler, reader_context& ctx,
+                               size_t depth) {
+    if constexpr (has_skip_value_handler<Handler>::value) {
+      if(handler.skip_next_value()) {
+        skip_value_aux(stream, ctx.max_depth_, depth);
+        return;
+      }
+    }
+    parse_value_aux(stream, handler, ctx, depth);
+  }
+
+  template <typename ReadStream, typename Handler>
+  static void parse_array_aux(ReadStream& stream, Handler& handler, reader_context& ctx,
+                              uint64_t length, size_t depth) {
+    CALL(handler.handle_start_array());
+    for(uint64_t i = 0; length == INDEFINITE ? !is_break_aux(stream) : i < length; i++)
+      parse_member_aux(stream, handler, ctx, depth);
+    CALL(handler.handle_end_array());
+  }
+
+  template <typename ReadStream, typename Handler>
+  static void parse_object_aux(ReadStream& stream, Handler& handler, reader_context& ctx,
+                               uint64_t length, size_t depth) {
+    CALL(handler.handle_start_object());
+    for(uint64_t i = 0; length == INDEFINITE ? !is_break_aux(stream) : i < length; i++) {
+      unsigned char head = next_aux(stream);
+      if((head >> 5) != BINARY_STRING)
+        throw json_exception(PARSE_MISS_KEY);
+      ctx.string_buffer_.clear();
+      read_string_aux(stream, read_argument_aux(stream, head & 0x1f), ctx.string_buffer_);
+      CALL(handler.handle_key(ctx.string_buffer_));
+      parse_member_aux(stream, handler, ctx, depth);
+    }
+    CALL(handler.handle_end_object());
+  }
+
+  // 跳过一个 value：string 和浮点数按长度前移，array 和 object 只需逐个跳过其成员
+  template <typename ReadStream>
+  static void skip_value_aux(ReadStream& stream, size_t max_depth, size_t depth) {
+    unsigned char head = next_aux(stream);
+    unsigned info = head & 0x1f;
+    if((head >> 5) >= BINARY_ARRAY && (head >> 5) <= BINARY_TAG && depth >= max_depth)
+      throw json_exception(PARSE_DEPTH_EXCEEDED);
+    switch(head >> 5) {
+      case BINARY_UNSIGNED:
+      case BINARY_NEGATIVE:
+        if(info == 31)
+          throw json_exception(PARSE_BAD_BINARY);
+        read_argument_aux(stream, info);
+        return;
+      case BINARY_BYTES:
+      case BINARY_STRING: {
+        uint64_t length = read_argument_aux(stream, info);
+        if(length == INDEFINITE) {
+          while(!is_break_aux(stream))
+            skip_value_aux(stream, max_depth, depth);
+          return;
+        }
+        for(uint64_t i = 0; i < length; i++)
+          next_aux(stream);
+        return;
+      }
+      case BINARY_ARRAY:
+      case BINARY_OBJECT: {
+        uint64_t length = read_argument_aux(stream, info);
+        uint64_t factor = (head >> 5) == BINARY_OBJECT ? 2 : 1;
+        if(length == INDEFINITE) {
+          while(!is_break_aux(stream)) {
+            for(uint64_t j = 0; j < factor; j++)
+              skip_value_aux(stream, max_depth, depth + 1);
+          }
+          return;
+        }
+        for(uint64_t i = 0; i < length * factor; i++)
+          skip_value_aux(stream, max_depth, depth + 1);
+        return;
+      }
+      case BINARY_TAG:
+        read_argument_aux(stream, info);
+        skip_value_aux(stream, max_depth, depth + 1);
+        return;
+      default:
+        if(info == 31)
+          throw json_exception(PARSE_BAD_BINARY);
+        read_argument_aux(stream, info);
+        return;
+    }
+  }
+#undef CALL
+};
+
+}
+
+#endif
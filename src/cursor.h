@@ -0,0 +1,287 @@
+#ifndef _CURSOR_H_
+#define _CURSOR_H_
+
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include "exception.h"
+#include "value.h"
+#include "reader.h"
+
+namespace json2 {
+
+/**
+ * @description: cursor 是拉取式（pull）的解析接口：与 reader 向 handler 推送（push）所有事件不同，
+ *      cursor 只在调用者需要时才解析下一个 value，按文档的顺序只向前移动，适合按已知的结构提取数据：
+ *  ```
+ *    // {"id": 7, "tags": ["a", "b"], "extra": {...}}
+ *    string_read_stream in(json);
+ *    cursor cur(in);
+ *    std::string_view key;
+ *    cur.enter_object();
+ *    while(cur.next_key(key)) {
+ *      if(key == "id") {
+ *        id = cur.get_int64();
+ *      } else if(key == "tags") {
+ *        cur.enter_array();
+ *        while(cur.next_element())
+ *          tags.emplace_back(cur.get_string());
+ *      } else {
+ *        cur.skip();                   // 不需要的 value 只匹配括号和引号，既不解码也不转换
+ *      }
+ *    }
+ *  ```
+ *  - enter_object() / enter_array() 进入 object / array；next_key() / next_element() 移动到下一个成员，
+ *    遇到 '}' / ']' 时返回 false，并退出该 object / array
+ *  - 每次 next_key() 或 next_element() 返回 true 之后，必须恰好读取（get_*()、enter_*()）或 skip() 一个 value
+ *  - get_string() 和 next_key() 返回的 std::string_view 指向 cursor 内部复用的 buffer，
+ *    分别在下一次调用 get_string() / next_key() 之前有效
+ *  - peek_type() 返回下一个 value 的类型而不移动 cursor，数字统一返回 TYPE_NUMBER。
+ *    注意这里的 TYPE_NUMBER 表示“任意数字”（之后可以按 get_int32() / get_int64() / get_uint64() /
+ *    get_double() 读取），与 value 中表示未转换的原始文本的 TYPE_NUMBER（见 PARSE_FLAG_RAW_NUMBER）不同
+ *  数字和 string 的解析直接使用 reader 中的实现，解析过程中除 buffer 的扩容之外不分配内存。
+ *  输入不合法时抛出 json_exception，其 error() 与 reader::parse() 返回的错误相同；
+ *  value 的类型与调用的函数不符时（如对 string 调用 get_int64()）抛出 PARSE_TYPE_MISMATCH。
+ */
+template <typename ReadStream, unsigned flags = PARSE_FLAG_DEFAULT>
+class cursor {
+  static_assert((flags & (PARSE_FLAG_RAW | PARSE_FLAG_RAW_NUMBER)) == 0,
+                "cursor decodes every value it returns");
+
+public:
+  cursor(const cursor&) = delete;
+  cursor& operator=(const cursor&) = delete;
+
+  explicit cursor(ReadStream& stream) :
+    stream_(stream),
+    first_(false) {}
+
+  value_type peek_type() {
+    reader::parse_whitespace(stream_);
+    switch(stream_.peek()) {
+      case 'n':
+        return TYPE_NULL;
+      case 't':
+      case 'f':
+        return TYPE_BOOL;
+      case '"':
+        return TYPE_STRING;
+      case '[':
+        return TYPE_ARRAY;
+      case '{':
+        return TYPE_OBJECT;
+      case '-':
+      case '0' ... '9':
+      case 'N':
+      case 'I':
+        return TYPE_NUMBER;
+      default:
+        throw json_exception(stream_.has_next() ? PARSE_BAD_VALUE : PARSE_EXPECT_VALUE);
+    }
+  }
+
+  void enter_object() {
+    enter_aux('{');
+  }
+
+  void enter_array() {
+    enter_aux('[');
+  }
+
+  // 移动到当前 object 的下一个成员，并通过 key 返回其 key；遇到 '}' 时返回 false
+  bool next_key(std::string_view& key) {
+    assert(!context_.stack_.empty() && context_.stack_.back() == '{');
+    if(!next_aux('}', PARSE_MISS_COMMA_OR_CURLY_BRACKET))
+      return false;
+    if(stream_.peek() != '"')
+      throw json_exception(PARSE_MISS_KEY);
+    reader::template parse_string<flags>(stream_, capture_, context_, true);
+    reader::parse_whitespace(stream_);
+    if(stream_.peek() != ':')
+      throw json_exception(PARSE_MISS_COLON);
+    stream_.next();
+    key = capture_.key_;
+    return true;
+  }
+
+  // 移动到当前 array 的下一个元素；遇到 ']' 时返回 false
+  bool next_element() {
+    assert(!context_.stack_.empty() && context_.stack_.back() == '[');
+    return next_aux(']', PARSE_MISS_COMMA_OR_SQUARE_BRACKET);
+  }
+
+  void get_null() {
+    if(get_scalar_aux() != capture::NULL_VALUE)
+      throw json_exception(PARSE_TYPE_MISMATCH);
+  }
+
+  bool get_bool() {
+    if(get_scalar_aux() != capture::BOOL_VALUE)
+      throw json_exception(PARSE_TYPE_MISMATCH);
+    return capture_.bool_;
+  }
+
+  int32_t get_int32() {
+    int64_t val = get_int64();
+    if(val < std::numeric_limits<int32_t>::min() || val > std::numeric_limits<int32_t>::max())
+      throw json_exception(PARSE_NUMBER_TOO_BIG);
+    return static_cast<int32_t>(val);
+  }
+
+  int64_t get_int64() {
+    auto kind = get_scalar_aux();
+    if(kind == capture::INT64_VALUE)
+      return capture_.int64_;
+    if(kind == capture::UINT64_VALUE)
+      throw json_exception(PARSE_NUMBER_TOO_BIG);
+    throw json_exception(PARSE_TYPE_MISMATCH);
+  }
+
+  uint64_t get_uint64() {
+    auto kind = get_scalar_aux();
+    if(kind == capture::UINT64_VALUE)
+      return capture_.uint64_;
+    if(kind == capture::INT64_VALUE && capture_.int64_ >= 0)
+      return static_cast<uint64_t>(capture_.int64_);
+    throw json_exception(kind == capture::INT64_VALUE ? PARSE_NUMBER_TOO_BIG : PARSE_TYPE_MISMATCH);
+  }
+
+  // 整数也可以按 double 读取
+  double get_double() {
+    switch(get_scalar_aux()) {
+      case capture::DOUBLE_VALUE:
+        return capture_.double_;
+      case capture::INT64_VALUE:
+        return static_cast<double>(capture_.int64_);
+      case capture::UINT64_VALUE:
+        return static_cast<double>(capture_.uint64_);
+      default:
+        throw json_exception(PARSE_TYPE_MISMATCH);
+    }
+  }
+
+  std::string_view get_string() {
+    if(get_scalar_aux() != capture::STRING_VALUE)
+      throw json_exception(PARSE_TYPE_MISMATCH);
+    return capture_.string_;
+  }
+
+  // 将下一个 value（必须是 null、bool、数字或 string）以事件的形式发送给 handler，
+  // 数字按其范围发送 handle_int32()、handle_int64()、handle_uint64() 或 handle_double()，与 reader 相同
+  template <typename Handler>
+  void get_scalar(Handler& handler) {
+    get_scalar_aux(handler);
+  }
+
+  // 跳过下一个 value（可以是整个 array 或 object），见 reader::skip()
+  void skip() {
+    reader::parse_whitespace(stream_);
+    reader::skip_value_aux(stream_);
+    first_ = false;
+  }
+
+  // 所有 value 都已读取完毕，且 root 之后只有空白字符
+  bool is_end() {
+    reader::parse_whitespace(stream_);
+    return context_.stack_.empty() && !stream_.has_next();
+  }
+
+  // 见 reader_context::max_depth_
+  void set_max_depth(size_t max_depth) {
+    context_.max_depth_ = max_depth;
+  }
+
+private:
+  // 接收 reader 为单个 value 发出的事件。整数统一保存为 int64_t，
+  // 超出 int64_t 范围的正整数单独以 UINT64_VALUE 表示（不使用 value_type，避免与 value 的 TYPE_NUMBER 混淆）
+  struct capture {
+    enum kind_type { NULL_VALUE, BOOL_VALUE, INT64_VALUE, UINT64_VALUE, DOUBLE_VALUE, STRING_VALUE };
+
+    bool handle_null() { kind_ = NULL_VALUE; return true; }
+    bool handle_bool(bool val) { kind_ = BOOL_VALUE; bool_ = val; return true; }
+    bool handle_int32(int32_t val) { kind_ = INT64_VALUE; int64_ = val; return true; }
+    bool handle_int64(int64_t val) { kind_ = INT64_VALUE; int64_ = val; return true; }
+    bool handle_uint64(uint64_t val) { kind_ = UINT64_VALUE; uint64_ = val; return true; }
+    bool handle_double(double val) { kind_ = DOUBLE_VALUE; double_ = val; return true; }
+    bool handle_string(const std::string& str) { kind_ = STRING_VALUE; string_ = str; return true; }
+    bool handle_key(const std::string& key) { key_.assign(key); return true; }
+
+    kind_type kind_ = NULL_VALUE;
+    bool bool_ = false;
+    int64_t int64_ = 0;
+    uint64_t uint64_ = 0;
+    double double_ = 0;
+    std::string_view string_;   // 指向 context_.string_buffer_
+    std::string key_;           // key 与 string 使用不同的 buffer，读取 value 之后 key 仍然有效
+  };
+
+  typename capture::kind_type get_scalar_aux() {
+    get_scalar_aux(capture_);
+    return capture_.kind_;
+  }
+
+  template <typename Handler>
+  void get_scalar_aux(Handler& handler) {
+    switch(peek_type()) {
+      case TYPE_NULL:
+        reader::parse_literal_aux(stream_, handler, "null", TYPE_NULL);
+        break;
+      case TYPE_BOOL:
+        if(stream_.peek() == 't')
+          reader::parse_literal_aux(stream_, handler, "true", TYPE_BOOL);
+        else
+          reader::parse_literal_aux(stream_, handler, "false", TYPE_BOOL);
+        break;
+      case TYPE_STRING:
+        reader::template parse_string<flags>(stream_, handler, context_, false);
+        break;
+      case TYPE_NUMBER:
+        reader::template parse_number<flags>(stream_, handler, context_);
+        break;
+      default:
+        throw json_exception(PARSE_TYPE_MISMATCH);
+    }
+    first_ = false;
+  }
+
+  void enter_aux(char open) {
+    reader::parse_whitespace(stream_);
+    if(stream_.peek() != open)
+      throw json_exception(stream_.has_next() ? PARSE_TYPE_MISMATCH : PARSE_EXPECT_VALUE);
+    reader::check_depth_aux(context_);
+    stream_.next();
+    context_.stack_.push_back(open);
+    first_ = true;
+  }
+
+  // 处理成员之间的 ','，遇到 close 时退出当前的 array / object 并返回 false
+  bool next_aux(char close, parse_error miss) {
+    reader::parse_whitespace(stream_);
+    if(stream_.peek() == close) {
+      stream_.next();
+      context_.stack_.pop_back();
+      first_ = false;
+      return false;
+    }
+    if(!first_) {
+      if(stream_.peek() != ',')
+        throw json_exception(miss);
+      stream_.next();
+      reader::parse_whitespace(stream_);
+    }
+    first_ = false;
+    return true;
+  }
+
+private:
+  ReadStream& stream_;
+  reader_context context_;    // 复用 reader 的 buffer，stack_ 保存当前所在的各层 '[' / '{'
+  capture capture_;
+  bool first_;                // 刚刚进入 array / object，下一个成员之前没有 ','
+};
+
+}
+
+#endif
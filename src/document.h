@@ -0,0 +1,267 @@
+#ifndef _DOCUMENT_H_
+#define _DOCUMENT_H_
+
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "exception.h"
+#include "value.h"
+#include "reader.h"
+
+namespace json2 {
+
+/**
+ * @description: document 是一个 handler，它接收 reader 发出的事件，并在自身（即一个 value）
+ *      之上构建树形存储结构，即 SAX -> DOM
+ *
+ *  e.g.
+ *  ```
+ *    document doc;
+ *    string_read_stream in(json);
+ *    parse_error err = doc.parse(in);
+ *  ```
+ *
+ *  以 document doc(true) 构造时，对于元素全部为整数或全部为浮点数的 array（如时间序列、坐标等），
+ *  document 会将其构建为紧凑数组（TYPE_INT64_ARRAY / TYPE_DOUBLE_ARRAY），而不是每个元素一个 value。
+ *  整数与浮点数混合、或含有其他类型元素的 array，仍然构建为普通的 TYPE_ARRAY。
+ *  紧凑数组只能通过 get_int64_array_value() / get_double_array_value()、非 const 的 operator[]
+ *  （会先展开）或 write_to() 访问，const 的 get_array_value() / operator[] 不支持，因此默认不开启
+ *
+ *  以 PARSE_FLAG_RAW_NUMBER 解析时（doc.parse<PARSE_FLAG_RAW_NUMBER>(in)），数字保存为
+ *  TYPE_NUMBER，即只保存原始文本，读取时才转换（见 value::set_raw_number()）
+ */
+class document : public value {
+public:
+  document(const document&) = delete;
+  document& operator=(const document&) = delete;
+
+  explicit document(bool pack_numeric_array = false) :
+    pack_numeric_array_(pack_numeric_array),
+    see_value_(false) {}
+
+  template <unsigned flags = PARSE_FLAG_DEFAULT, typename ReadStream>
+  parse_error parse(ReadStream& stream) {
+    reset_aux();
+    return reader::parse<flags>(stream, *this, context_);
+  }
+
+  // 与 parse() 相同，但只解析 stream 中的下一个 value（见 reader::parse_next()）
+  template <unsigned flags = PARSE_FLAG_DEFAULT, typename ReadStream>
+  parse_error parse_next(ReadStream& stream) {
+    reset_aux();
+    return reader::parse_next<flags>(stream, *this, context_);
+  }
+
+  // 见 reader_context::max_depth_
+  void set_max_depth(size_t max_depth) {
+    context_.max_depth_ = max_depth;
+  }
+
+#ifdef JSON2_ENABLE_STATS
+  stats& get_stats() {
+    return context_.stats_;
+  }
+#endif
+
+public:
+  bool handle_null() {
+    add_value_aux(value(TYPE_NULL));
+    return true;
+  }
+
+  bool handle_bool(bool val) {
+    add_value_aux(value(val));
+    return true;
+  }
+
+  bool handle_int32(int32_t val) {
+    if(!add_packed_aux(static_cast<int64_t>(val)))
+      add_value_aux(value(val));
+    return true;
+  }
+
+  bool handle_int64(int64_t val) {
+    if(!add_packed_aux(val))
+      add_value_aux(value(val));
+    return true;
+  }
+
+  bool handle_double(double val) {
+    if(!add_packed_aux(val))
+      add_value_aux(value(val));
+    return true;
+  }
+
+  // PARSE_FLAG_RAW_NUMBER 模式下的数字保存为 TYPE_NUMBER，不参与紧凑数组
+  bool handle_raw_number(std::string_view raw) {
+    value val;
+    val.set_raw_number(raw);
+    add_value_aux(std::move(val));
+    return true;
+  }
+
+  bool handle_string(std::string str) {
+    add_value_aux(value(std::move(str)));
+    return true;
+  }
+
+  bool handle_start_object() {
+    value* val = add_value_aux(value(TYPE_OBJECT));
+    stack_.emplace_back(val, TYPE_ARRAY);
+    return true;
+  }
+
+  bool handle_key(std::string key) {
+    add_value_aux(value(std::move(key)));
+    return true;
+  }
+
+  bool handle_end_object() {
+    assert(!stack_.empty());
+    assert(stack_.back().value_->get_type() == TYPE_OBJECT);
+    stack_.pop_back();
+    return true;
+  }
+
+  bool handle_start_array() {
+    value* val = add_value_aux(value(TYPE_ARRAY));
+    // TYPE_NULL 表示元素类型尚未确定，TYPE_ARRAY 表示不使用紧凑数组
+    stack_.emplace_back(val, pack_numeric_array_ ? TYPE_NULL : TYPE_ARRAY);
+    return true;
+  }
+
+  bool handle_end_array() {
+    assert(!stack_.empty());
+    auto& top = stack_.back();
+    assert(top.value_->get_type() == TYPE_ARRAY);
+    if(top.packed_type_ == TYPE_INT64_ARRAY) {
+      *top.value_ = value(std::move(top.int64s_));
+    } else if(top.packed_type_ == TYPE_DOUBLE_ARRAY) {
+      *top.value_ = value(std::move(top.doubles_));
+    }
+    stack_.pop_back();
+    return true;
+  }
+
+protected:
+  // 重新 parse 时，需要先将之前的结果清空
+  void reset_aux() {
+    set_null();
+    stack_.clear();
+    see_value_ = false;
+  }
+
+private:
+  // level 表示当前正在构建的 array 或 object
+  struct level {
+  public:
+    level(value* val, value_type packed_type) :
+      value_(val),
+      value_count_(0),
+      packed_type_(packed_type) {}
+
+  public:
+    value* value_;
+    int value_count_;
+    // 对于 array，packed_type_ 表示紧凑数组的候选类型：
+    //   - TYPE_NULL：还没有遇到元素
+    //   - TYPE_INT64_ARRAY / TYPE_DOUBLE_ARRAY：目前所有元素都暂存在 int64s_ / doubles_ 中
+    //   - TYPE_ARRAY：已经放弃紧凑数组，元素直接加入 value_
+    value_type packed_type_;
+    std::vector<int64_t> int64s_;
+    std::vector<double> doubles_;
+  };
+
+  // 若当前处于紧凑数组的候选状态，则将数字暂存起来并返回 true
+  bool add_packed_aux(int64_t val) {
+    if(stack_.empty())
+      return false;
+    auto& top = stack_.back();
+    if(top.packed_type_ == TYPE_NULL || top.packed_type_ == TYPE_INT64_ARRAY) {
+      top.packed_type_ = TYPE_INT64_ARRAY;
+      top.int64s_.push_back(val);
+      top.value_count_++;
+      return true;
+    }
+    return false;
+  }
+
+  bool add_packed_aux(double val) {
+    if(stack_.empty())
+      return false;
+    auto& top = stack_.back();
+    if(top.packed_type_ == TYPE_NULL || top.packed_type_ == TYPE_DOUBLE_ARRAY) {
+      top.packed_type_ = TYPE_DOUBLE_ARRAY;
+      top.doubles_.push_back(val);
+      top.value_count_++;
+      return true;
+    }
+    return false;
+  }
+
+  // 遇到与候选类型不同的元素时，放弃紧凑数组，将已暂存的数字转为普通的 value
+  void unpack_aux(level& top) {
+    auto& values = top.value_->array_value_->data_;
+    if(top.packed_type_ == TYPE_INT64_ARRAY) {
+      for(int64_t val : top.int64s_) {
+        if(val >= std::numeric_limits<int32_t>::min() &&
+           val <= std::numeric_limits<int32_t>::max())
+          values.emplace_back(static_cast<int32_t>(val));
+        else
+          values.emplace_back(val);
+      }
+      top.int64s_.clear();
+    } else if(top.packed_type_ == TYPE_DOUBLE_ARRAY) {
+      for(double val : top.doubles_)
+        values.emplace_back(val);
+      top.doubles_.clear();
+    }
+    top.packed_type_ = TYPE_ARRAY;
+  }
+
+  value* add_value_aux(value&& val) {
+    if(see_value_) {
+      assert(!stack_.empty() && "root not singular");
+    } else {
+      assert(get_type() == TYPE_NULL);
+      see_value_ = true;
+      value::operator=(std::move(val));
+      return this;
+    }
+
+    auto& top = stack_.back();
+    if(top.value_->get_type() == TYPE_ARRAY) {
+      if(top.packed_type_ != TYPE_ARRAY)
+        unpack_aux(top);
+      top.value_->add_value(std::move(val));
+      top.value_count_++;
+      return &top.value_->array_value_->data_.back();
+    }
+
+    // 对于 object，偶数个 value 是 key，奇数个 value 才是真正的值
+    if(top.value_count_ % 2 == 0) {
+      assert(val.get_type() == TYPE_STRING && "miss quotation mark");
+      key_ = std::move(val);
+      top.value_count_++;
+      return &key_;
+    }
+    top.value_count_++;
+    return &top.value_->add_element(std::move(key_), std::move(val));
+  }
+
+protected:
+  reader_context context_; // 同一个 document 反复解析时复用 reader 的 buffer
+
+private:
+  std::vector<level> stack_;
+  value key_;
+  bool pack_numeric_array_;
+  bool see_value_;
+};
+
+}
+
+#endif
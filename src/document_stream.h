@@ -0,0 +1,312 @@
+#ifndef _DOCUMENT_STREAM_H_
+#define _DOCUMENT_STREAM_H_
+
+#include <cassert>
+#include <cerrno>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <unistd.h>
+#include "exception.h"
+#include "value.h"
+#include "reader.h"
+#include "read_stream.h"
+#include "document.h"
+
+namespace json2 {
+
+/**
+ * @description: document_stream 用于解析首尾相连的多个 json（concatenated JSON），例如：
+ *      {"a":1}{"a":2} [3] "x" 4 5
+ *  root 之间可以没有任何分隔符，也可以有任意的空白字符（不要求按行分隔，这一点与 ndjson_reader 不同）。
+ *  reader::parse() 遇到这样的输入会返回 PARSE_ROOT_NOT_SINGULAR，而 document_stream 依次交付每一个 root：
+ *  ```
+ *    document_stream stream(STDIN_FILENO);
+ *    for(document& doc : stream)          // 每个 root 依次解析到同一个 document 中
+ *      handle(doc);
+ *    if(stream.get_error() != PARSE_OK)
+ *      ...
+ *
+ *    // 或者使用 SAX 的方式
+ *    while(stream.has_next()) {
+ *      if(stream.parse_next(handler) != PARSE_OK)
+ *        ...                              // 出错的 root 已被跳过，可以选择继续解析之后的 root
+ *    }
+ *  ```
+ *  数据通过 read() 从文件描述符 fd（文件、管道、socket 等）中按块读入一个 buffer，buffer 的初始大小为
+ *  window_size，只有当某一个 root 本身比 buffer 更大时才会扩容，因此对于无尽的管道，内存占用只与最大的
+ *  root 有关。已经解析完的数据在下一次读入之前被移出 buffer。
+ *  buffer 最多扩容到 max_root_size，超过它的 root 不会被解析，而是扫描到其结尾之后丢弃，并返回
+ *  PARSE_ROOT_TOO_LARGE，因此内存占用总有上限，即使输入中有一个没有结尾的 root。
+ *  read() 在有数据到达时立即返回，管道中已经完整到达的 root 不需要等待 buffer 被填满即可交付。
+ *
+ *  每个 root 的边界由一个只匹配引号、转义字符和括号的扫描确定（与 skip_next_value() 类似），
+ *  之后再交给 reader 在 [begin, end) 上完整地解析，因此边界之外的内容不会影响该 root 的解析结果。
+ *  reader_context 以及 document 在所有 root 之间复用。
+ */
+class document_stream {
+public:
+  document_stream(const document_stream&) = delete;
+  document_stream& operator=(const document_stream&) = delete;
+
+  // max_root_size 为单个 root 的最大字节数（见 refill_aux()）
+  explicit document_stream(int fd, size_t window_size = 1 << 16, size_t max_root_size = 1 << 28) :
+    fd_(fd),
+    eof_(false),
+    max_root_size_(max_root_size == 0 ? 1 : max_root_size),
+    buffer_(std::min(window_size == 0 ? 1 : window_size, max_root_size_)),
+    begin_(0),
+    end_(0),
+    consumed_(0),
+    offset_(0),
+    error_(PARSE_OK) {
+    reset_scan_aux();
+  }
+
+  // 跳过空白字符，若之后还有 root 则返回 true（必要时会阻塞等待数据）
+  bool has_next() {
+    while(true) {
+      skip_whitespace_aux();
+      if(begin_ != end_)
+        return true;
+      if(eof_)
+        return false;
+      refill_aux();
+    }
+  }
+
+  // 解析下一个 root，并将其事件发送给 handler。调用之前需要先确认 has_next()
+  // 无论成功与否，stream 都会停在该 root 之后
+  template <unsigned flags = PARSE_FLAG_DEFAULT, typename Handler>
+  parse_error parse_next(Handler& handler) {
+    return parse_next_aux([&](memory_read_stream& stream) {
+      return reader::parse<flags>(stream, handler, context_);
+    });
+  }
+
+  template <unsigned flags = PARSE_FLAG_DEFAULT>
+  parse_error parse_next(document& doc) {
+    return parse_next_aux([&](memory_read_stream& stream) {
+      return doc.template parse<flags>(stream);
+    });
+  }
+
+  // 最近一次解析的 root 在整个输入中的字节偏移量，出错时可以用来定位
+  size_t get_offset() const {
+    return offset_;
+  }
+
+  // 通过 iterator 遍历时遇到的错误，遍历在第一个错误处结束
+  parse_error get_error() const {
+    return error_;
+  }
+
+  // 见 reader_context::max_depth_
+  void set_max_depth(size_t max_depth) {
+    context_.max_depth_ = max_depth;
+    doc_.set_max_depth(max_depth);
+  }
+
+public:
+  class iterator {
+  public:
+    explicit iterator(document_stream* stream) :
+      stream_(stream) {
+      next_aux();
+    }
+
+    document& operator*() const {
+      return stream_->doc_;
+    }
+
+    document* operator->() const {
+      return &stream_->doc_;
+    }
+
+    iterator& operator++() {
+      next_aux();
+      return *this;
+    }
+
+    bool operator==(const iterator& rhs) const {
+      return stream_ == rhs.stream_;
+    }
+
+    bool operator!=(const iterator& rhs) const {
+      return stream_ != rhs.stream_;
+    }
+
+  private:
+    // 解析下一个 root 到 stream_->doc_ 中，没有更多的 root 或者出错时变为 end()
+    void next_aux() {
+      if(stream_ == nullptr)
+        return;
+      if(!stream_->has_next()) {
+        stream_ = nullptr;
+        return;
+      }
+      stream_->error_ = stream_->parse_next(stream_->doc_);
+      if(stream_->error_ != PARSE_OK)
+        stream_ = nullptr;
+    }
+
+  private:
+    document_stream* stream_;
+  };
+
+  iterator begin() {
+    error_ = PARSE_OK;
+    return iterator(this);
+  }
+
+  iterator end() {
+    return iterator(nullptr);
+  }
+
+private:
+  template <typename Parse>
+  parse_error parse_next_aux(Parse parse) {
+    offset_ = consumed_ + begin_;
+    size_t last = find_root_aux();
+    parse_error err = PARSE_ROOT_TOO_LARGE;
+    if(!too_large_) {
+      memory_read_stream stream(buffer_.data() + begin_, buffer_.data() + last);
+      err = parse(stream);
+    }
+    begin_ = last;
+    reset_scan_aux();
+    return err;
+  }
+
+  static bool is_whitespace_aux(char ch) {
+    return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
+  }
+
+  void skip_whitespace_aux() {
+    while(begin_ != end_ && is_whitespace_aux(buffer_[begin_]))
+      begin_++;
+    if(scan_ < begin_)
+      scan_ = begin_;
+  }
+
+  void reset_scan_aux() {
+    scan_ = begin_;
+    depth_ = 0;
+    started_ = false;
+    in_string_ = false;
+    escaped_ = false;
+    too_large_ = false;
+  }
+
+  // 返回从 begin_ 开始的 root 的结束位置，数据不完整时读入更多的数据；
+  // 输入在 root 结束之前就已经结束时，返回 end_，由 reader 报告相应的错误
+  size_t find_root_aux() {
+    assert(begin_ != end_ && !is_whitespace_aux(buffer_[begin_]));
+    while(true) {
+      for(; scan_ != end_; scan_++) {
+        char ch = buffer_[scan_];
+        // 第一个字符决定 root 的种类
+        if(!started_) {
+          started_ = true;
+          is_container_ = ch == '{' || ch == '[';
+          is_string_ = ch == '"';
+          depth_ = is_container_;
+          in_string_ = is_string_;
+          continue;
+        }
+        if(in_string_) {
+          if(escaped_)
+            escaped_ = false;
+          else if(ch == '\\')
+            escaped_ = true;
+          else if(ch == '"') {
+            in_string_ = false;
+            if(is_string_)
+              return scan_ + 1;
+          }
+        } else if(is_container_) {
+          if(ch == '"') {
+            in_string_ = true;
+          } else if(ch == '{' || ch == '[') {
+            depth_++;
+          } else if(ch == '}' || ch == ']') {
+            if(--depth_ == 0)
+              return scan_ + 1;
+          }
+        } else if(is_whitespace_aux(ch) || strchr("{}[]\",", ch) != nullptr) {
+          // 数字、true 等字面量以空白字符或下一个 root 的开始为结束
+          return scan_;
+        }
+      }
+      if(eof_)
+        return end_;
+      if(end_ - begin_ >= max_root_size_)
+        discard_root_aux();
+      refill_aux();
+    }
+  }
+
+  // 当前的 root 已经达到 max_root_size_ 却仍未结束：丢弃 buffer_ 中的所有数据（都已扫描过），
+  // 之后只继续扫描以找到该 root 的结尾，不再保存其内容
+  void discard_root_aux() {
+    too_large_ = true;
+    consumed_ += end_;
+    begin_ = 0;
+    end_ = 0;
+    scan_ = 0;
+  }
+
+  // 将尚未解析的数据移到 buffer_ 的开头，buffer_ 已满（即一个 root 比 buffer_ 更大）时扩容，
+  // 但不超过 max_root_size_，然后读入更多的数据
+  void refill_aux() {
+    if(begin_ != 0) {
+      memmove(buffer_.data(), buffer_.data() + begin_, end_ - begin_);
+      consumed_ += begin_;
+      end_ -= begin_;
+      scan_ -= begin_;
+      begin_ = 0;
+    }
+    if(end_ == buffer_.size())
+      buffer_.resize(std::min(buffer_.size() * 2, std::max(max_root_size_, buffer_.size())));
+    while(true) {
+      ssize_t count = ::read(fd_, buffer_.data() + end_, buffer_.size() - end_);
+      if(count > 0) {
+        end_ += static_cast<size_t>(count);
+        return;
+      }
+      // 被信号中断时重新读取，其余的错误按输入结束处理
+      if(count < 0 && errno == EINTR)
+        continue;
+      eof_ = true;
+      return;
+    }
+  }
+
+private:
+  int fd_;
+  bool eof_;
+  size_t max_root_size_;
+  std::vector<char> buffer_;
+  size_t begin_;      // 下一个 root（或其之前的空白字符）在 buffer_ 中的位置
+  size_t end_;        // buffer_ 中有效数据的结束位置
+  size_t consumed_;   // 已经移出 buffer_ 的字节数
+  size_t offset_;
+
+  // 查找 root 边界的扫描状态，读入更多数据之后从 scan_ 处继续，不需要从头扫描
+  size_t scan_;
+  size_t depth_;
+  bool started_;      // 是否已经读到 root 的第一个字符，它决定了 root 的种类
+  bool is_container_;
+  bool is_string_;
+  bool in_string_;
+  bool escaped_;
+  bool too_large_;    // 当前的 root 超过了 max_root_size_，其内容已被丢弃
+
+  reader_context context_;
+  document doc_;
+  parse_error error_;
+};
+
+}
+
+#endif
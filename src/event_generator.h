@@ -0,0 +1,265 @@
+#ifndef _EVENT_GENERATOR_H_
+#define _EVENT_GENERATOR_H_
+
+// event_generator 需要 C++20 的协程（coroutine），以更低的标准编译时本文件不提供任何内容
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+
+#include <cassert>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "exception.h"
+#include "value.h"
+#include "reader.h"
+#include "cursor.h"
+
+namespace json2 {
+
+// 与 handler 的各个 handle_*() 一一对应，EVENT_ERROR 表示解析出错（此后不会再有任何事件）
+enum event_type {
+  EVENT_NULL,
+  EVENT_BOOL,
+  EVENT_INT32,
+  EVENT_INT64,
+  EVENT_UINT64,
+  EVENT_DOUBLE,
+  EVENT_STRING,
+  EVENT_KEY,
+  EVENT_START_OBJECT,
+  EVENT_END_OBJECT,
+  EVENT_START_ARRAY,
+  EVENT_END_ARRAY,
+  EVENT_ERROR,
+};
+
+struct event {
+public:
+  // 将事件发送给 handler（例如 writer），即调用对应的 handle_*()
+  template <typename Handler>
+  bool write_to(Handler& handler) const {
+    switch(type_) {
+      case EVENT_NULL:
+        return handler.handle_null();
+      case EVENT_BOOL:
+        return handler.handle_bool(bool_value_);
+      case EVENT_INT32:
+        return handler.handle_int32(static_cast<int32_t>(int64_value_));
+      case EVENT_INT64:
+        return handler.handle_int64(int64_value_);
+      case EVENT_UINT64:
+        return dispatch_uint64(handler, uint64_value_);
+      case EVENT_DOUBLE:
+        return handler.handle_double(double_value_);
+      case EVENT_STRING:
+        return handler.handle_string(std::string(string_value_));
+      case EVENT_KEY:
+        return handler.handle_key(std::string(string_value_));
+      case EVENT_START_OBJECT:
+        return handler.handle_start_object();
+      case EVENT_END_OBJECT:
+        return handler.handle_end_object();
+      case EVENT_START_ARRAY:
+        return handler.handle_start_array();
+      case EVENT_END_ARRAY:
+        return handler.handle_end_array();
+      default:
+        return false;
+    }
+  }
+
+public:
+  event_type type_ = EVENT_NULL;
+  bool bool_value_ = false;
+  int64_t int64_value_ = 0;         // EVENT_INT32 和 EVENT_INT64
+  uint64_t uint64_value_ = 0;
+  double double_value_ = 0;
+  std::string_view string_value_;   // EVENT_STRING 和 EVENT_KEY，在生成下一个事件之前有效
+  parse_error error_ = PARSE_OK;    // EVENT_ERROR
+};
+
+/**
+ * @description: event_generator 以协程的方式产生解析事件：每次 next() 只解析到下一个事件为止，
+ *      然后挂起，直到调用者再次 next()。与 reader::parse() 一次性地把所有事件推给 handler 不同，
+ *      调用者可以在任意两个事件之间暂停，例如在同一个线程的事件循环中交替地解析多个很大的 body，
+ *      既不需要额外的线程，也不需要先把所有事件保存下来：
+ *  ```
+ *    string_read_stream in(body);
+ *    event_generator events = parse_events(in);
+ *    while(events.next()) {
+ *      const event& e = events.get();
+ *      if(e.type_ == EVENT_ERROR)
+ *        return e.error_;
+ *      e.write_to(handler);          // 或者按 e.type_ 直接处理
+ *      if(need_yield())
+ *        co_await ...;               // 调用者自己的调度，下一次 next() 从这里继续
+ *    }
+ *  ```
+ *  事件的顺序与 reader::parse() 发给 handler 的完全相同，数字和 string 的解析直接使用 reader 的实现
+ *  （见 cursor::get_scalar()）。stream 必须在 event_generator 结束（或析构）之前一直有效。
+ *  需要以 C++20 编译。
+ */
+class event_generator {
+public:
+  struct promise_type {
+    event_generator get_return_object() {
+      return event_generator(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+
+    // 创建时先挂起，第一次 next() 时才开始解析
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_always final_suspend() noexcept { return {}; }
+
+    std::suspend_always yield_value(const event& e) noexcept {
+      event_ = &e;
+      return {};
+    }
+
+    void return_void() {}
+
+    void unhandled_exception() {
+      exception_ = std::current_exception();
+    }
+
+    const event* event_ = nullptr;
+    std::exception_ptr exception_;
+  };
+
+public:
+  event_generator(const event_generator&) = delete;
+  event_generator& operator=(const event_generator&) = delete;
+
+  event_generator(event_generator&& rhs) noexcept :
+    handle_(std::exchange(rhs.handle_, nullptr)) {}
+
+  event_generator& operator=(event_generator&& rhs) noexcept {
+    if(this != &rhs) {
+      if(handle_)
+        handle_.destroy();
+      handle_ = std::exchange(rhs.handle_, nullptr);
+    }
+    return *this;
+  }
+
+  ~event_generator() {
+    if(handle_)
+      handle_.destroy();
+  }
+
+  // 解析到下一个事件，没有更多的事件时返回 false
+  bool next() {
+    if(!handle_ || handle_.done())
+      return false;
+    handle_.resume();
+    if(handle_.promise().exception_)
+      std::rethrow_exception(handle_.promise().exception_);
+    return !handle_.done();
+  }
+
+  const event& get() const {
+    assert(handle_ && !handle_.done());
+    return *handle_.promise().event_;
+  }
+
+private:
+  explicit event_generator(std::coroutine_handle<promise_type> handle) :
+    handle_(handle) {}
+
+private:
+  std::coroutine_handle<promise_type> handle_;
+};
+
+// event_capture 将 cursor::get_scalar() 发出的事件转换为 event，供 parse_events() 使用
+struct event_capture {
+  bool handle_null() { event_.type_ = EVENT_NULL; return true; }
+  bool handle_bool(bool val) { event_.type_ = EVENT_BOOL; event_.bool_value_ = val; return true; }
+  bool handle_int32(int32_t val) { event_.type_ = EVENT_INT32; event_.int64_value_ = val; return true; }
+  bool handle_int64(int64_t val) { event_.type_ = EVENT_INT64; event_.int64_value_ = val; return true; }
+  bool handle_uint64(uint64_t val) { event_.type_ = EVENT_UINT64; event_.uint64_value_ = val; return true; }
+  bool handle_double(double val) { event_.type_ = EVENT_DOUBLE; event_.double_value_ = val; return true; }
+  bool handle_string(const std::string& str) {
+    event_.type_ = EVENT_STRING;
+    event_.string_value_ = str;
+    return true;
+  }
+  // key 由 cursor::next_key() 解析，不会经过这里
+  bool handle_key(const std::string&) { return true; }
+
+  event event_;
+};
+
+// parse_events() 与 reader::parse() 一样要求 stream 中只有一个 root，
+// 其后还有其他内容时产生 PARSE_ROOT_NOT_SINGULAR 的 EVENT_ERROR
+template <unsigned flags = PARSE_FLAG_DEFAULT, typename ReadStream>
+event_generator parse_events(ReadStream& stream, size_t max_depth = reader_context().max_depth_) {
+  cursor<ReadStream, flags> cur(stream);
+  cur.set_max_depth(max_depth);
+  event_capture capture;
+  event& e = capture.event_;
+  // 当前所在的各层 array / object，cursor 内部也有一份，这里只用于决定下一步调用 next_key() 还是 next_element()
+  std::vector<char> stack;
+  parse_error err = PARSE_OK;
+  try {
+    bool need_value = true;
+    while(true) {
+      if(need_value) {
+        switch(cur.peek_type()) {
+          case TYPE_OBJECT:
+            cur.enter_object();
+            stack.push_back('{');
+            e.type_ = EVENT_START_OBJECT;
+            break;
+          case TYPE_ARRAY:
+            cur.enter_array();
+            stack.push_back('[');
+            e.type_ = EVENT_START_ARRAY;
+            break;
+          default:
+            cur.get_scalar(capture);
+            break;
+        }
+        co_yield e;
+        need_value = false;
+      }
+      if(stack.empty())
+        break;
+      if(stack.back() == '{') {
+        std::string_view key;
+        if(cur.next_key(key)) {
+          e.type_ = EVENT_KEY;
+          e.string_value_ = key;
+          need_value = true;
+        } else {
+          stack.pop_back();
+          e.type_ = EVENT_END_OBJECT;
+        }
+      } else {
+        if(cur.next_element()) {
+          need_value = true;
+          continue;
+        }
+        stack.pop_back();
+        e.type_ = EVENT_END_ARRAY;
+      }
+      co_yield e;
+    }
+    if(!cur.is_end())
+      err = PARSE_ROOT_NOT_SINGULAR;
+  } catch(json_exception& ex) {
+    err = ex.error();
+  }
+  if(err != PARSE_OK) {
+    e.type_ = EVENT_ERROR;
+    e.error_ = err;
+    co_yield e;
+  }
+}
+
+}
+
+#endif
+
+#endif
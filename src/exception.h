@@ -31,6 +31,14 @@ namespace json2 {
   XX(MISS_COLON, "miss colon")                                    \
   XX(MISS_COMMA_OR_CURLY_BRACKET, "miss comma or curly bracket")  \
   XX(USER_STOPPED, "user stopped parse")                          \
+  XX(TYPE_MISMATCH, "type mismatch")                              \
+  XX(BAD_BINARY, "bad binary value")                              \
+  XX(DEPTH_EXCEEDED, "nesting too deep")                          \
+  XX(BAD_UTF8, "invalid utf-8")                                   \
+  XX(BAD_SCHEMA, "bad or unsupported schema")                     \
+  XX(SCHEMA_MISMATCH, "schema mismatch")                          \
+  XX(BAD_FILE, "cannot open or map file")                         \
+  XX(ROOT_TOO_LARGE, "root too large")                            \
 
 // parse_error 这个 enum 用于表示在 parse json 过程中的各种错误
 // 错误形式例如：PARSE_OK, PARSE_ROOT_NET_SINGULAR
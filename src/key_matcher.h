@@ -0,0 +1,264 @@
+#ifndef _KEY_MATCHER_H_
+#define _KEY_MATCHER_H_
+
+#include <cassert>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace json2 {
+
+// 计算 key 的 hash。sparse 为 true 时只取长度以及首、中、尾三个字节，只需几条指令；
+// 否则依次混入所有字节（FNV-1a），用于只靠这几个字节无法区分的 key
+constexpr uint64_t key_hash(std::string_view key, bool sparse) {
+  uint64_t h = 0xCBF29CE484222325ull ^ key.size();
+  if(sparse) {
+    if(!key.empty()) {
+      h ^= static_cast<uint64_t>(static_cast<unsigned char>(key[0])) << 16;
+      h ^= static_cast<uint64_t>(static_cast<unsigned char>(key[key.size() / 2])) << 24;
+      h ^= static_cast<uint64_t>(static_cast<unsigned char>(key[key.size() - 1])) << 32;
+    }
+  } else {
+    for(char ch : key)
+      h = (h ^ static_cast<unsigned char>(ch)) * 0x100000001B3ull;
+  }
+  return h;
+}
+
+// 第 i 个候选的 seed，hash 乘以 seed 之后取最高的若干位作为下标，因此 seed 必须为奇数
+constexpr uint64_t key_seed(uint32_t i) {
+  return 0x9E3779B97F4A7C15ull * (2 * static_cast<uint64_t>(i) + 1);
+}
+
+// table 的长度为不小于 key 个数 2 倍的 2 的幂（至少为 4），bucket 的个数为其一半
+constexpr unsigned key_table_bits(size_t size) {
+  unsigned bits = 2;
+  while((size_t(1) << bits) < size * 2)
+    bits++;
+  return bits;
+}
+
+constexpr size_t key_table_size(size_t size) {
+  return size_t(1) << key_table_bits(size);
+}
+
+constexpr size_t key_bucket_index(uint64_t h, uint64_t seed, unsigned bits) {
+  return static_cast<size_t>((h * seed) >> (65 - bits));
+}
+
+constexpr size_t key_slot_index(uint64_t h, uint64_t disp, unsigned bits) {
+  return static_cast<size_t>((h * disp) >> (64 - bits));
+}
+
+// 构建过程中 disps 先保存每个 bucket 中 key 的个数，已放置的 bucket 保存 key_placed_flag + 候选 seed 的序号
+constexpr uint64_t key_placed_flag = uint64_t(1) << 32;
+
+// 为 bucket 中的所有 key 寻找一个 seed，使它们都落在 table 中不同的空位上
+template <typename Keys, typename Table, typename Disps>
+constexpr bool place_key_bucket_aux(const Keys& keys, size_t size, Table& table, Disps& disps,
+                                    size_t bucket, unsigned bits, uint64_t seed, bool sparse) {
+  for(uint32_t i = 0; i < 4096; i++) {
+    uint64_t disp = key_seed(i);
+    bool ok = true;
+    for(size_t k = 0; k < size && ok; k++) {
+      uint64_t h = key_hash(keys[k], sparse);
+      if(key_bucket_index(h, seed, bits) != bucket)
+        continue;
+      size_t slot = key_slot_index(h, disp, bits);
+      if(table[slot] != 0)
+        ok = false;
+      else
+        table[slot] = static_cast<uint16_t>(k + 1);
+    }
+    if(ok) {
+      disps[bucket] = key_placed_flag + i;
+      return true;
+    }
+    // 撤销本次尝试中已经放入的 key
+    for(size_t k = 0; k < size; k++) {
+      uint64_t h = key_hash(keys[k], sparse);
+      if(key_bucket_index(h, seed, bits) != bucket)
+        continue;
+      size_t slot = key_slot_index(h, disp, bits);
+      if(table[slot] == k + 1)
+        table[slot] = 0;
+    }
+  }
+  return false;
+}
+
+// 以给定的 seed 将 keys 分到各个 bucket，再从 key 最多的 bucket 开始依次放置（hash and displace）
+template <typename Keys, typename Table, typename Disps>
+constexpr bool fill_key_table_aux(const Keys& keys, size_t size, Table& table, Disps& disps,
+                                  uint64_t seed, bool sparse) {
+  unsigned bits = key_table_bits(size);
+  size_t buckets = key_table_size(size) / 2;
+  for(size_t i = 0; i < key_table_size(size); i++)
+    table[i] = 0;
+  for(size_t i = 0; i < buckets; i++)
+    disps[i] = 0;
+  uint64_t max_count = 0;
+  for(size_t k = 0; k < size; k++) {
+    size_t bucket = key_bucket_index(key_hash(keys[k], sparse), seed, bits);
+    if(++disps[bucket] > max_count)
+      max_count = disps[bucket];
+  }
+  for(uint64_t count = max_count; count > 0; count--) {
+    for(size_t i = 0; i < buckets; i++) {
+      if(disps[i] == count && !place_key_bucket_aux(keys, size, table, disps, i, bits, seed, sparse))
+        return false;
+    }
+  }
+  // 将序号转换为 seed，没有 key 的 bucket 使用任意的 seed 即可
+  for(size_t i = 0; i < buckets; i++)
+    disps[i] = key_seed(disps[i] >= key_placed_flag ? static_cast<uint32_t>(disps[i] - key_placed_flag) : 0);
+  return true;
+}
+
+// hash 相同的两个 key 无论选择哪个 seed 都会冲突
+template <typename Keys>
+constexpr bool has_equal_hash_aux(const Keys& keys, size_t size, bool sparse) {
+  for(size_t i = 0; i < size; i++) {
+    for(size_t j = i + 1; j < size; j++) {
+      if(key_hash(keys[i], sparse) == key_hash(keys[j], sparse))
+        return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @description: 为 keys 构建完美 hash（没有冲突的 hash）：先以 seed 将 key 分到 table 长度一半的 bucket 中，
+ *      再为每个 bucket 选择一个 seed（disps）将其中的 key 放到 table 的空位上，查找时只需两次乘法和一次查表。
+ *      优先使用只取首、中、尾字节的 hash，无法区分时才使用所有字节的 hash。
+ *      table 的长度为 key_table_size(size)，disps 的长度为其一半。
+ *      keys 中有重复时无法构建，此时 assert 失败（编译期构建时表现为编译错误）
+ */
+template <typename Keys, typename Table, typename Disps>
+constexpr void build_key_table_aux(const Keys& keys, size_t size, Table& table, Disps& disps,
+                                   uint64_t& seed, bool& sparse) {
+  for(int pass = 0; pass < 2; pass++) {
+    sparse = pass == 0;
+    if(has_equal_hash_aux(keys, size, sparse))
+      continue;
+    for(uint32_t i = 0; i < 4; i++) {
+      seed = key_seed(i);
+      if(fill_key_table_aux(keys, size, table, disps, seed, sparse))
+        return;
+    }
+  }
+  assert(false && "duplicate keys");
+}
+
+/**
+ * @description: key_matcher 在编译期由一组字符串常量构建，运行时将 key 映射为其在这组字符串中的下标，
+ *      只需计算一次 hash、查两次表以及一次比较，不需要依次与每个字符串比较：
+ *  ```
+ *    enum { ID, NAME, SCORES };
+ *    static constexpr auto keys = make_key_matcher("id", "name", "scores");
+ *
+ *    bool handle_key(const std::string& key) {
+ *      switch(keys.find(key)) {
+ *        case ID: ...
+ *        case NAME: ...
+ *        case SCORES: ...
+ *        default: ...                // 未知的 key，即 keys.size()
+ *      }
+ *    }
+ *  ```
+ *  keys 中不能有重复的字符串，最多 65535 个。
+ */
+template <size_t N>
+class key_matcher {
+  static_assert(N < 65536, "too many keys");
+
+public:
+  constexpr explicit key_matcher(const std::array<std::string_view, N>& keys) :
+    keys_(keys),
+    table_(),
+    disps_(),
+    seed_(0),
+    sparse_(false) {
+    build_key_table_aux(keys_, N, table_, disps_, seed_, sparse_);
+  }
+
+  // 返回 key 的下标，未匹配时返回 size()
+  constexpr size_t find(std::string_view key) const {
+    constexpr unsigned bits = key_table_bits(N);
+    uint64_t h = key_hash(key, sparse_);
+    uint16_t index = table_[key_slot_index(h, disps_[key_bucket_index(h, seed_, bits)], bits)];
+    if(index == 0 || keys_[index - 1] != key)
+      return N;
+    return index - 1;
+  }
+
+  constexpr size_t size() const {
+    return N;
+  }
+
+  constexpr std::string_view operator[](size_t index) const {
+    return keys_[index];
+  }
+
+private:
+  std::array<std::string_view, N> keys_;
+  std::array<uint16_t, key_table_size(N)> table_;    // key 的下标 + 1，0 表示空
+  std::array<uint64_t, key_table_size(N) / 2> disps_;
+  uint64_t seed_;
+  bool sparse_;
+};
+
+template <typename... Keys>
+constexpr key_matcher<sizeof...(Keys)> make_key_matcher(const Keys&... keys) {
+  return key_matcher<sizeof...(Keys)>({std::string_view(keys)...});
+}
+
+// dynamic_key_matcher 与 key_matcher 相同，但 keys 在运行时才确定（例如 projection_document 的路径）
+class dynamic_key_matcher {
+public:
+  dynamic_key_matcher() :
+    dynamic_key_matcher(std::vector<std::string>()) {}
+
+  explicit dynamic_key_matcher(std::vector<std::string> keys) :
+    keys_(std::move(keys)),
+    table_(key_table_size(keys_.size())),
+    disps_(key_table_size(keys_.size()) / 2),
+    bits_(key_table_bits(keys_.size())),
+    seed_(0),
+    sparse_(false) {
+    assert(keys_.size() < 65536 && "too many keys");
+    build_key_table_aux(keys_, keys_.size(), table_, disps_, seed_, sparse_);
+  }
+
+  size_t find(std::string_view key) const {
+    uint64_t h = key_hash(key, sparse_);
+    uint16_t index = table_[key_slot_index(h, disps_[key_bucket_index(h, seed_, bits_)], bits_)];
+    if(index == 0 || keys_[index - 1] != key)
+      return keys_.size();
+    return index - 1;
+  }
+
+  size_t size() const {
+    return keys_.size();
+  }
+
+  const std::string& operator[](size_t index) const {
+    return keys_[index];
+  }
+
+private:
+  std::vector<std::string> keys_;
+  std::vector<uint16_t> table_;
+  std::vector<uint64_t> disps_;
+  unsigned bits_;
+  uint64_t seed_;
+  bool sparse_;
+};
+
+}
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef _MAPPED_TAPE_H_
+#define _MAPPED_TAPE_H_
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "tape.h"
+
+namespace json2 {
+
+/**
+ * @description: mapped_tape 以只读的方式 mmap 一个由 tape_document::save() 生成的文件，
+ *      并通过 tape_cursor 直接在映射的内存上查询，不需要任何解析或反序列化：
+ *  ```
+ *    // 生成文件（只需一次）
+ *    tape_document tape;
+ *    tape.parse(in);                      // 或者 tape.freeze(doc);
+ *    FILE* output = fopen("ref.tape", "wb");
+ *    file_write_stream out(output);
+ *    tape.save(out);
+ *
+ *    // 使用文件
+ *    mapped_tape mapped;
+ *    if(mapped.open("ref.tape"))
+ *      int64_t id = mapped.root()["items"][0]["id"].get_int64_value();
+ *  ```
+ *  映射使用 MAP_SHARED，多个进程打开同一个文件时共享 page cache 中的同一份物理内存，
+ *  并且只有实际访问到的页面才会从磁盘读入，因此打开一个很大的文件也只需要几毫秒。
+ *  注：open() 只检查头部以及文件大小，tape 的内容本身不做校验，因此文件应当来自可信的 save()。
+ */
+class mapped_tape {
+public:
+  mapped_tape(const mapped_tape&) = delete;
+  mapped_tape& operator=(const mapped_tape&) = delete;
+
+  mapped_tape() :
+    data_(nullptr),
+    size_(0) {}
+
+  mapped_tape(mapped_tape&& rhs) :
+    data_(rhs.data_),
+    size_(rhs.size_) {
+    rhs.data_ = nullptr;
+    rhs.size_ = 0;
+  }
+
+  mapped_tape& operator=(mapped_tape&& rhs) {
+    if(this != &rhs) {
+      close();
+      std::swap(data_, rhs.data_);
+      std::swap(size_, rhs.size_);
+    }
+    return *this;
+  }
+
+  ~mapped_tape() {
+    close();
+  }
+
+  // 打开并映射 path，文件不存在、不是 tape 文件或者字节序不同时返回 false
+  bool open(const char* path) {
+    close();
+    int fd = ::open(path, O_RDONLY);
+    if(fd < 0)
+      return false;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(tape_file_header)) {
+      ::close(fd);
+      return false;
+    }
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // 映射建立之后，关闭 fd 不影响映射
+    ::close(fd);
+    if(data == MAP_FAILED)
+      return false;
+    data_ = static_cast<const char*>(data);
+    size_ = static_cast<size_t>(st.st_size);
+    if(!check_header_aux()) {
+      close();
+      return false;
+    }
+    return true;
+  }
+
+  void close() {
+    if(data_ != nullptr)
+      munmap(const_cast<char*>(data_), size_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  bool is_open() const {
+    return data_ != nullptr;
+  }
+
+  tape_cursor root() const {
+    assert(is_open());
+    const char* tape = data_ + sizeof(tape_file_header);
+    const char* strings = tape + header_aux().tape_size_ * sizeof(uint64_t);
+    return tape_cursor(reinterpret_cast<const uint64_t*>(tape), strings, 0);
+  }
+
+private:
+  const tape_file_header& header_aux() const {
+    return *reinterpret_cast<const tape_file_header*>(data_);
+  }
+
+  bool check_header_aux() const {
+    const tape_file_header& header = header_aux();
+    tape_file_header expect;
+    if(memcmp(header.magic_, expect.magic_, sizeof(expect.magic_)) != 0 ||
+       header.version_ != expect.version_ || header.byte_order_ != expect.byte_order_)
+      return false;
+    // 检查各部分的大小与文件大小一致，避免访问到映射之外的内存
+    size_t body = size_ - sizeof(tape_file_header);
+    if(header.tape_size_ == 0 || header.tape_size_ > body / sizeof(uint64_t))
+      return false;
+    return header.tape_size_ * sizeof(uint64_t) + header.strings_size_ == body;
+  }
+
+private:
+  const char* data_;
+  size_t size_;
+};
+
+}
+
+#endif
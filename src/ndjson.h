@@ -0,0 +1,328 @@
+#ifndef _NDJSON_H_
+#define _NDJSON_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "exception.h"
+#include "value.h"
+#include "reader.h"
+#include "read_stream.h"
+#include "document.h"
+#include "task_pool.h"
+
+namespace json2 {
+
+struct ndjson_options {
+  unsigned threads = 0;        // 0 表示使用 std::thread::hardware_concurrency() 个线程
+  size_t chunk_size = 1 << 20; // 每个 chunk 的大致字节数，chunk 的边界总是对齐到换行符
+  bool ordered = false;        // 为 true 时，按行的顺序在调用线程中交付结果
+  size_t window = 0;           // 有序模式下最多领先交付多少个 chunk，0 表示 2 * 线程数
+};
+
+/**
+ * @description: ndjson_reader 用于并行解析 NDJSON（JSON Lines），即每行一个 json 的输入。
+ *      输入首先被切分为若干个以换行符对齐的 chunk，然后由 task_pool 的各个 worker 并行解析，
+ *      空行（只含空白字符的行）会被跳过。行的位置以该行在 data 中的字节偏移量 offset 表示。
+ *
+ *  1. parse()：每行解析为一个 value，并调用 callback(size_t offset, value& val)
+ *      - 无序（默认）：每个 worker 复用一个 document，callback 在各个 worker 线程中并发调用
+ *      - 有序（options.ordered）：callback 在调用线程中按行的顺序调用
+ *  2. parse_sax()：每个 worker 一个 Handler，该 worker 解析的所有行的事件都发送给它，
+ *      因此 Handler 需要能接收多个 root（例如统计类的 handler）
+ *
+ *  3. parse_file()：与 parse() 相同，但输入为文件，文件以只读的方式 mmap，不需要先读入 std::string
+ *
+ *  遇到错误时，返回第一个出错的行的错误，并通过 error_offset 返回该行的 offset。
+ *  有序模式保证出错行之前的所有行都已交付；无序模式下，出错行之后的行也可能已经交付。
+ *  有序模式下 worker 按顺序领取 chunk，并且最多领先交付 options.window 个 chunk，
+ *  因此暂存的结果（value）最多只有 window + 1 个 chunk，与输入的大小无关。
+ *  callback（或 parse_sax() 的 Handler）抛出异常时，两种模式都会先停止并等待所有 worker，
+ *  再将第一个异常抛给调用者（无序模式见 task_pool::run()）。
+ */
+class ndjson_reader {
+public:
+  ndjson_reader(const ndjson_reader&) = delete;
+  ndjson_reader& operator=(const ndjson_reader&) = delete;
+
+public:
+  template <unsigned flags = PARSE_FLAG_DEFAULT, typename Callback>
+  static parse_error parse(const std::string& data, Callback callback,
+                           const ndjson_options& options = ndjson_options(),
+                           size_t* error_offset = nullptr) {
+    return parse_aux<flags>(std::string_view(data), callback, options, error_offset);
+  }
+
+  // 文件无法打开或映射时返回 PARSE_BAD_FILE
+  template <unsigned flags = PARSE_FLAG_DEFAULT, typename Callback>
+  static parse_error parse_file(const char* path, Callback callback,
+                                const ndjson_options& options = ndjson_options(),
+                                size_t* error_offset = nullptr) {
+    int fd = ::open(path, O_RDONLY);
+    if(fd < 0)
+      return PARSE_BAD_FILE;
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+      ::close(fd);
+      return PARSE_BAD_FILE;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    if(size == 0) {
+      ::close(fd);
+      return PARSE_OK;
+    }
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // 映射建立之后，关闭 fd 不影响映射
+    ::close(fd);
+    if(data == MAP_FAILED)
+      return PARSE_BAD_FILE;
+    // 每个 chunk 都是顺序读取的
+    madvise(data, size, MADV_SEQUENTIAL);
+    parse_error err;
+    try {
+      err = parse_aux<flags>(std::string_view(static_cast<const char*>(data), size),
+                             callback, options, error_offset);
+    } catch(...) {
+      munmap(data, size);
+      throw;
+    }
+    munmap(data, size);
+    return err;
+  }
+
+  template <unsigned flags = PARSE_FLAG_DEFAULT, typename Handler>
+  static parse_error parse_sax(const std::string& data, std::vector<Handler>& handlers,
+                               size_t chunk_size = ndjson_options().chunk_size,
+                               size_t* error_offset = nullptr) {
+    assert(!handlers.empty());
+    auto chunks = split_chunks_aux(std::string_view(data), chunk_size);
+    task_pool pool(static_cast<unsigned>(handlers.size()));
+    std::vector<reader_context> contexts(pool.size());
+    error_state error;
+    pool.run(chunks.size() - 1, [&](unsigned worker, size_t idx) {
+      parse_chunk_aux(std::string_view(data), chunks, idx, error, [&](memory_read_stream& stream, size_t) {
+        return reader::parse<flags>(stream, handlers[worker], contexts[worker]);
+      });
+    });
+    return error.result(error_offset);
+  }
+
+private:
+  template <unsigned flags, typename Callback>
+  static parse_error parse_aux(std::string_view data, Callback& callback,
+                               const ndjson_options& options, size_t* error_offset) {
+    auto chunks = split_chunks_aux(data, options.chunk_size);
+    task_pool pool(options.threads);
+    std::unique_ptr<document[]> docs(new document[pool.size()]);
+    error_state error;
+
+    if(!options.ordered) {
+      pool.run(chunks.size() - 1, [&](unsigned worker, size_t idx) {
+        auto& doc = docs[worker];
+        parse_chunk_aux(data, chunks, idx, error, [&](memory_read_stream& stream, size_t offset) {
+          parse_error err = doc.template parse<flags>(stream);
+          if(err == PARSE_OK)
+            callback(offset, static_cast<value&>(doc));
+          return err;
+        });
+      });
+      return error.result(error_offset);
+    }
+
+    // 有序模式：worker 按顺序领取 chunk，将结果暂存在 results[idx % window] 中，调用线程按顺序依次交付。
+    // task_pool 按连续的区间分配任务，不适合按顺序领取，因此每个 worker 只执行一个任务，在其中循环领取 chunk
+    struct chunk_result {
+      std::vector<std::pair<size_t, value>> values_;
+      bool ready_ = false;
+    };
+    size_t count = chunks.size() - 1;
+    size_t window = options.window > 0 ? options.window : 2 * static_cast<size_t>(pool.size());
+    std::vector<chunk_result> results(std::min(window, std::max<size_t>(count, 1)));
+    window = results.size();
+    size_t next = 0;         // 下一个待领取的 chunk
+    size_t delivered = 0;    // 已经开始交付的 chunk 个数
+    bool stopped = false;
+    std::exception_ptr worker_error;  // worker 解析时抛出的异常（如 std::bad_alloc），由调用线程重新抛出
+    std::mutex mutex;
+    std::condition_variable cond;
+
+    std::thread producer([&] {
+      pool.run(pool.size(), [&](unsigned worker, size_t) {
+        auto& doc = docs[worker];
+        try {
+          while(true) {
+            size_t idx;
+            {
+              std::unique_lock<std::mutex> lock(mutex);
+              cond.wait(lock, [&] { return stopped || next == count || next < delivered + window; });
+              if(stopped || next == count)
+                return;
+              idx = next++;
+            }
+            std::vector<std::pair<size_t, value>> values;
+            parse_chunk_aux(data, chunks, idx, error, [&](memory_read_stream& stream, size_t offset) {
+              parse_error err = doc.template parse<flags>(stream);
+              if(err == PARSE_OK)
+                values.emplace_back(offset, std::move(static_cast<value&>(doc)));
+              return err;
+            });
+            {
+              std::lock_guard<std::mutex> lock(mutex);
+              results[idx % window].values_ = std::move(values);
+              results[idx % window].ready_ = true;
+            }
+            cond.notify_all();
+          }
+        } catch(...) {
+          // 让其他 worker 以及等待结果的调用线程都停下来
+          {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(!worker_error)
+              worker_error = std::current_exception();
+            stopped = true;
+          }
+          cond.notify_all();
+        }
+      });
+    });
+
+    // 无论正常结束、遇到错误还是 callback 抛出异常，都要先让 worker 停止并等待 producer 结束
+    auto stop = [&] {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+      }
+      cond.notify_all();
+      producer.join();
+    };
+
+    try {
+      for(size_t idx = 0; idx < count; idx++) {
+        std::vector<std::pair<size_t, value>> values;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          auto& result = results[idx % window];
+          cond.wait(lock, [&] { return result.ready_ || worker_error; });
+          if(!result.ready_)
+            break;
+          values = std::move(result.values_);
+          result.ready_ = false;
+          delivered = idx + 1;
+        }
+        cond.notify_all();
+        for(auto& val : values)
+          callback(val.first, val.second);
+        // 出错的 chunk 中，出错行之前的行已经交付，之后的 chunk 不再交付
+        if(error.first_chunk_.load() == idx)
+          break;
+      }
+    } catch(...) {
+      stop();
+      throw;
+    }
+    stop();
+    if(worker_error)
+      std::rethrow_exception(worker_error);
+    return error.result(error_offset);
+  }
+
+  // 记录所有 worker 中第一个（即 offset 最小的）错误
+  struct error_state {
+    error_state() :
+      first_chunk_(std::numeric_limits<size_t>::max()),
+      error_(PARSE_OK),
+      offset_(std::numeric_limits<size_t>::max()) {}
+
+    void record(size_t chunk, size_t offset, parse_error err) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if(offset < offset_) {
+        offset_ = offset;
+        error_ = err;
+        first_chunk_.store(chunk);
+      }
+    }
+
+    parse_error result(size_t* error_offset) {
+      if(error_offset != nullptr && error_ != PARSE_OK)
+        *error_offset = offset_;
+      return error_;
+    }
+
+    // 编号大于 first_chunk_ 的 chunk 不需要再解析
+    std::atomic<size_t> first_chunk_;
+    std::mutex mutex_;
+    parse_error error_;
+    size_t offset_;
+  };
+
+  // 返回 chunk 的边界，第 i 个 chunk 为 [bounds[i], bounds[i + 1])
+  static std::vector<size_t> split_chunks_aux(std::string_view data, size_t chunk_size) {
+    std::vector<size_t> bounds{0};
+    size_t size = data.size();
+    size_t pos = 0;
+    if(chunk_size == 0)
+      chunk_size = 1;
+    while(pos < size) {
+      size_t next = pos + chunk_size;
+      if(next >= size) {
+        next = size;
+      } else {
+        auto newline = static_cast<const char*>(memchr(data.data() + next, '\n', size - next));
+        next = newline != nullptr ? newline - data.data() + 1 : size;
+      }
+      bounds.push_back(next);
+      pos = next;
+    }
+    return bounds;
+  }
+
+  static bool is_blank_aux(const char* first, const char* last) {
+    for(; first != last; first++) {
+      if(*first != ' ' && *first != '\t' && *first != '\r')
+        return false;
+    }
+    return true;
+  }
+
+  // 依次解析第 idx 个 chunk 中的每一行，parse_line 返回 parse_error
+  template <typename ParseLine>
+  static void parse_chunk_aux(std::string_view data, const std::vector<size_t>& bounds,
+                              size_t idx, error_state& error, ParseLine parse_line) {
+    if(idx > error.first_chunk_.load())
+      return;
+    const char* base = data.data();
+    const char* iter = base + bounds[idx];
+    const char* last = base + bounds[idx + 1];
+    while(iter < last) {
+      auto newline = static_cast<const char*>(memchr(iter, '\n', last - iter));
+      const char* end = newline != nullptr ? newline : last;
+      if(!is_blank_aux(iter, end)) {
+        memory_read_stream stream(iter, end);
+        parse_error err = parse_line(stream, static_cast<size_t>(iter - base));
+        if(err != PARSE_OK) {
+          error.record(idx, static_cast<size_t>(iter - base), err);
+          return;
+        }
+      }
+      iter = end + 1;
+    }
+  }
+};
+
+}
+
+#endif
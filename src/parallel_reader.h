@@ -0,0 +1,178 @@
+#ifndef _PARALLEL_READER_H_
+#define _PARALLEL_READER_H_
+
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "exception.h"
+#include "value.h"
+#include "reader.h"
+#include "read_stream.h"
+#include "document.h"
+#include "task_pool.h"
+
+namespace json2 {
+
+struct parallel_array_options {
+  unsigned threads = 0;        // 0 表示使用 std::thread::hardware_concurrency() 个线程
+  size_t chunk_size = 1 << 20; // 每个 chunk 的大致字节数
+};
+
+/**
+ * @description: parallel_array_reader 用于并行解析 root 为一个巨大 array 的 json，
+ *      例如 [ {...}, {...}, ... ]
+ *
+ *  1. 预扫描：顺序扫描一遍输入，只识别引号、转义字符和括号，从而找到 depth 为 1 的 ','，
+ *     也就是 root array 中相邻两个元素之间的分隔符。每隔约 chunk_size 个字节，在这样的 ','
+ *     之后切分一次，得到若干个 chunk。由于预扫描不解码 string、不转换数字，速度远高于完整的解析。
+ *  2. 并行解析：各个 worker 用 document::parse_next() 依次解析 chunk 中的每个元素，
+ *     每个元素都是一个独立的 value。
+ *  3. 拼接：按 chunk 的顺序将所有元素加入 result 这个 array 中。
+ *
+ *  每个元素都必须恰好是一个合法的 json value，因此预扫描的切分不会放过任何不合法的输入。
+ *  若 root 不是 array，则退化为普通的顺序解析。
+ */
+class parallel_array_reader {
+public:
+  parallel_array_reader(const parallel_array_reader&) = delete;
+  parallel_array_reader& operator=(const parallel_array_reader&) = delete;
+
+public:
+  template <unsigned flags = PARSE_FLAG_DEFAULT>
+  static parse_error parse(const std::string& data, value& result,
+                           const parallel_array_options& options = parallel_array_options()) {
+    const char* iter = skip_whitespace_aux(data.data(), data.data() + data.size());
+    if(iter == data.data() + data.size() || *iter != '[') {
+      document doc;
+      memory_read_stream stream(data.data(), data.data() + data.size());
+      parse_error err = doc.parse<flags>(stream);
+      if(err == PARSE_OK)
+        result = std::move(static_cast<value&>(doc));
+      return err;
+    }
+
+    std::vector<const char*> bounds;
+    parse_error err = split_chunks_aux(iter, data.data() + data.size(),
+                                       options.chunk_size, bounds);
+    if(err != PARSE_OK)
+      return err;
+
+    // 只有一个 chunk 并且只含空白字符，说明是空 array
+    size_t count = bounds.size() - 1;
+    result.set_array();
+    if(count == 1 && skip_whitespace_aux(bounds[0], bounds[1]) == bounds[1])
+      return PARSE_OK;
+
+    task_pool pool(options.threads);
+    std::vector<std::vector<value>> chunks(count);
+    std::vector<parse_error> errors(count, PARSE_OK);
+    std::atomic<size_t> first_error(std::numeric_limits<size_t>::max());
+    std::unique_ptr<document[]> docs(new document[pool.size()]);
+
+    pool.run(count, [&](unsigned worker, size_t idx) {
+      if(idx > first_error.load())
+        return;
+      errors[idx] = parse_chunk_aux<flags>(bounds[idx], bounds[idx + 1], idx + 1 == count,
+                                           docs[worker], chunks[idx]);
+      if(errors[idx] != PARSE_OK) {
+        size_t prev = first_error.load();
+        while(idx < prev && !first_error.compare_exchange_weak(prev, idx)) {}
+      }
+    });
+
+    if(first_error.load() != std::numeric_limits<size_t>::max()) {
+      result.set_null();
+      return errors[first_error.load()];
+    }
+    for(auto& chunk : chunks) {
+      for(auto& val : chunk)
+        result.add_value(std::move(val));
+      std::vector<value>().swap(chunk);
+    }
+    return PARSE_OK;
+  }
+
+private:
+  static const char* skip_whitespace_aux(const char* iter, const char* end) {
+    while(iter != end && (*iter == ' ' || *iter == '\t' || *iter == '\r' || *iter == '\n'))
+      iter++;
+    return iter;
+  }
+
+  // 预扫描：iter 指向 root array 的 '['。bounds 中相邻的两个指针构成一个 chunk，
+  // 除最后一个 chunk 以 ']' 之前为结束外，其余 chunk 都以 depth 为 1 的 ',' 结尾
+  static parse_error split_chunks_aux(const char* iter, const char* end, size_t chunk_size,
+                                      std::vector<const char*>& bounds) {
+    iter++;
+    bounds.push_back(iter);
+    int depth = 1;
+    while(iter != end) {
+      switch(*iter++) {
+        case '"':
+          // 跳过整个 string，'\\' 之后的一个字符不可能是 string 的结尾
+          while(iter != end && *iter != '"') {
+            if(*iter == '\\' && iter + 1 != end)
+              iter++;
+            iter++;
+          }
+          if(iter == end)
+            return PARSE_MISS_QUOTATION_MARK;
+          iter++;
+          break;
+        case '[':
+        case '{':
+          depth++;
+          break;
+        case ']':
+        case '}':
+          if(--depth == 0) {
+            // 元素内部括号不匹配的情况会在解析元素时发现，这里只需检查 root 本身
+            if(iter[-1] != ']')
+              return PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+            bounds.push_back(iter - 1);
+            if(skip_whitespace_aux(iter, end) != end)
+              return PARSE_ROOT_NOT_SINGULAR;
+            return PARSE_OK;
+          }
+          break;
+        case ',':
+          if(depth == 1 && static_cast<size_t>(iter - bounds.back()) >= chunk_size)
+            bounds.push_back(iter);
+          break;
+        default:
+          break;
+      }
+    }
+    return PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+  }
+
+  // 解析 [first, last) 中以 ',' 分隔的所有元素，除最后一个 chunk 外，last 之前一定是 ','
+  template <unsigned flags>
+  static parse_error parse_chunk_aux(const char* first, const char* last, bool is_last,
+                                     document& doc, std::vector<value>& values) {
+    memory_read_stream stream(first, last);
+    while(true) {
+      parse_error err = doc.parse_next<flags>(stream);
+      if(err != PARSE_OK)
+        return err;
+      values.push_back(std::move(static_cast<value&>(doc)));
+
+      while(stream.has_next() && (stream.peek() == ' ' || stream.peek() == '\t' ||
+                                  stream.peek() == '\r' || stream.peek() == '\n'))
+        stream.next();
+      if(!stream.has_next())
+        return is_last ? PARSE_OK : PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+      if(stream.next() != ',')
+        return PARSE_MISS_COMMA_OR_SQUARE_BRACKET;
+      if(!is_last && !stream.has_next())
+        return PARSE_OK;
+    }
+  }
+};
+
+}
+
+#endif
@@ -0,0 +1,255 @@
+#ifndef _PROJECTION_H_
+#define _PROJECTION_H_
+
+#include <cassert>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "exception.h"
+#include "value.h"
+#include "reader.h"
+#include "document.h"
+#include "key_matcher.h"
+
+namespace json2 {
+
+// @description: projection_document 只为选中的路径构建 DOM，其余的 value 都通过
+//      skip_next_value() 直接跳过（见 reader.h），既不解码也不分配内存。
+//
+//  路径采用 JSON Pointer（RFC 6901）的形式，并支持 '*' 通配任意 key 或 array 下标：
+//  ```
+//    projection_document doc({"/user/id", "/items/*/price"});
+//    parse_error err = doc.parse(in);
+//  ```
+//  对于输入：
+//    {"user": {"id": 7, "name": "x"}, "items": [{"price": 1, "sku": "a"}, {"price": 2}], "log": [...]}
+//  得到的 doc 为：
+//    {"user": {"id": 7}, "items": [{"price": 1}, {"price": 2}]}
+//
+//  - 选中路径上的 object / array 会被保留，但其中只包含被选中的成员；
+//  - 被选中的路径的终点处的 value 会被完整地构建；
+//  - 路径还没有结束却遇到 string、数字等 value 时（例如 items 中的某个元素是数字），该 value 会被丢弃；
+//  - array 中未被选中的元素会被丢弃，因此结果中的下标不一定与输入相同。
+class projection_document : public document {
+public:
+  projection_document(const projection_document&) = delete;
+  projection_document& operator=(const projection_document&) = delete;
+
+  explicit projection_document(const std::vector<std::string>& pointers,
+                               bool pack_numeric_array = true) :
+    document(pack_numeric_array) {
+    nodes_.emplace_back("");
+    for(const auto& pointer : pointers)
+      add_pointer_aux(pointer);
+    build_matchers_aux();
+  }
+
+  template <unsigned flags = PARSE_FLAG_DEFAULT, typename ReadStream>
+  parse_error parse(ReadStream& stream) {
+    reset_aux();
+    frames_.clear();
+    matched_ = {0};
+    full_ = nodes_[0].terminal_;
+    pending_key_ = false;
+    return reader::parse<flags>(stream, *this, context_);
+  }
+
+public:
+  bool skip_next_value() {
+    assert(!frames_.empty());
+    auto& top = frames_.back();
+    if(top.in_array_)
+      key_ = std::to_string(++top.index_);
+
+    matched_.clear();
+    full_ = false;
+    for(size_t node : top.nodes_) {
+      // 某个路径已经在上层结束，说明当前整个子树都被选中
+      if(nodes_[node].terminal_) {
+        matched_ = {node};
+        full_ = true;
+        break;
+      }
+      // 先通过 key_matcher 找到与 key_ 相同的子结点，再加上 '*'（key_ 本身为 "*" 时两者是同一个结点）
+      const auto& matcher = nodes_[node].matcher_;
+      size_t index = matcher.find(key_);
+      if(index != matcher.size())
+        match_child_aux(nodes_[node].children_[index]);
+      if(nodes_[node].wildcard_ != npos && nodes_[node].wildcard_ != index)
+        match_child_aux(nodes_[node].children_[nodes_[node].wildcard_]);
+    }
+    if(matched_.empty())
+      return true;
+    // key 推迟到确定保留该 value 时才交给 document
+    pending_key_ = !top.in_array_;
+    return false;
+  }
+
+  bool handle_null() {
+    return !keep_scalar_aux() || document::handle_null();
+  }
+
+  bool handle_bool(bool val) {
+    return !keep_scalar_aux() || document::handle_bool(val);
+  }
+
+  bool handle_int32(int32_t val) {
+    return !keep_scalar_aux() || document::handle_int32(val);
+  }
+
+  bool handle_int64(int64_t val) {
+    return !keep_scalar_aux() || document::handle_int64(val);
+  }
+
+  bool handle_double(double val) {
+    return !keep_scalar_aux() || document::handle_double(val);
+  }
+
+  bool handle_raw_number(std::string_view raw) {
+    return !keep_scalar_aux() || document::handle_raw_number(raw);
+  }
+
+  bool handle_string(std::string str) {
+    return !keep_scalar_aux() || document::handle_string(std::move(str));
+  }
+
+  bool handle_start_object() {
+    forward_key_aux();
+    frames_.emplace_back(false, std::move(matched_));
+    return document::handle_start_object();
+  }
+
+  bool handle_key(std::string key) {
+    key_ = std::move(key);
+    return true;
+  }
+
+  bool handle_end_object() {
+    frames_.pop_back();
+    return document::handle_end_object();
+  }
+
+  bool handle_start_array() {
+    forward_key_aux();
+    frames_.emplace_back(true, std::move(matched_));
+    return document::handle_start_array();
+  }
+
+  bool handle_end_array() {
+    frames_.pop_back();
+    return document::handle_end_array();
+  }
+
+private:
+  // 所有路径组成一棵 trie，nodes_[0] 为根结点，即空路径 ""
+  struct node {
+  public:
+    explicit node(std::string key) :
+      key_(std::move(key)),
+      terminal_(false),
+      wildcard_(npos) {}
+
+  public:
+    std::string key_;
+    bool terminal_; // 为 true 表示某个路径在此结束
+    std::vector<size_t> children_;
+    dynamic_key_matcher matcher_; // 所有子结点的 key，下标与 children_ 相同
+    size_t wildcard_;             // key 为 "*" 的子结点在 children_ 中的下标，没有时为 npos
+  };
+
+  // frame 表示当前所在的 array 或 object，以及与之匹配的 trie 结点
+  struct frame {
+  public:
+    frame(bool in_array, std::vector<size_t> nodes) :
+      in_array_(in_array),
+      index_(-1),
+      nodes_(std::move(nodes)) {}
+
+  public:
+    bool in_array_;
+    long index_; // array 中当前元素的下标
+    std::vector<size_t> nodes_;
+  };
+
+  void match_child_aux(size_t child) {
+    matched_.push_back(child);
+    full_ = full_ || nodes_[child].terminal_;
+  }
+
+  void forward_key_aux() {
+    if(pending_key_) {
+      pending_key_ = false;
+      document::handle_key(std::move(key_));
+    }
+  }
+
+  // 路径还没有结束，但遇到的却是 string、数字等不能再往下匹配的 value，则丢弃该 value
+  bool keep_scalar_aux() {
+    if(!frames_.empty() && !full_) {
+      pending_key_ = false;
+      return false;
+    }
+    forward_key_aux();
+    return true;
+  }
+
+  // 将 pointer 按 '/' 切分，并对 "~1"、"~0" 进行反转义，然后插入 trie 中
+  void add_pointer_aux(const std::string& pointer) {
+    assert((pointer.empty() || pointer[0] == '/') && "json pointer must start with '/'");
+    size_t current = 0;
+    size_t pos = 0;
+    while(pos < pointer.size()) {
+      size_t next = pointer.find('/', pos + 1);
+      if(next == std::string::npos)
+        next = pointer.size();
+      std::string key;
+      for(size_t i = pos + 1; i < next; i++) {
+        if(pointer[i] == '~' && i + 1 < next && (pointer[i + 1] == '0' || pointer[i + 1] == '1')) {
+          key.push_back(pointer[++i] == '0' ? '~' : '/');
+        } else {
+          key.push_back(pointer[i]);
+        }
+      }
+      current = find_or_add_child_aux(current, key);
+      pos = next;
+    }
+    nodes_[current].terminal_ = true;
+  }
+
+  size_t find_or_add_child_aux(size_t parent, const std::string& key) {
+    for(size_t child : nodes_[parent].children_) {
+      if(nodes_[child].key_ == key)
+        return child;
+    }
+    nodes_.emplace_back(key);
+    nodes_[parent].children_.push_back(nodes_.size() - 1);
+    return nodes_.size() - 1;
+  }
+
+  // 所有路径都插入之后，为每个结点构建子结点的 key_matcher
+  void build_matchers_aux() {
+    for(auto& n : nodes_) {
+      std::vector<std::string> keys;
+      for(size_t i = 0; i < n.children_.size(); i++) {
+        keys.push_back(nodes_[n.children_[i]].key_);
+        if(keys.back() == "*")
+          n.wildcard_ = i;
+      }
+      n.matcher_ = dynamic_key_matcher(std::move(keys));
+    }
+  }
+
+private:
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+  std::vector<node> nodes_;
+  std::vector<frame> frames_;
+  std::vector<size_t> matched_; // 最近一次 skip_next_value() 所匹配的结点，供下一个 array / object 使用
+  std::string key_;             // 当前成员的 key（array 中为下标）
+  bool full_ = false;           // 为 true 表示下一个 value 处于某个选中路径的终点或其之下
+  bool pending_key_ = false;    // 为 true 表示 key_ 还没有交给 document
+};
+
+}
+
+#endif
@@ -120,6 +120,51 @@ private:
   std::string data_;
   iterator iter_;
 };
+
+
+/*
+ * memory_read_stream 类：直接在一段已有的内存 [begin, end) 上读取，不拷贝也不持有数据，
+ *      主要用于在同一块 buffer 上解析多个片段（如 NDJSON 中的每一行）
+ */
+class memory_read_stream {
+public:
+  using iterator = const char*;
+
+public:
+  memory_read_stream(const memory_read_stream&) = delete;
+  memory_read_stream& operator=(const memory_read_stream&) = delete;
+
+  memory_read_stream(const char* begin, const char* end) :
+    iter_(begin),
+    end_(end) {}
+
+  bool has_next() const {
+    return iter_ != end_; 
+  }
+
+  char peek() {
+    return has_next() ? *iter_ : '\0'; 
+  }
+
+  iterator get_iterator() const {
+    return iter_; 
+  }
+
+  char next() {
+    if(has_next()) 
+      return *iter_++;
+    return '\0';
+  }
+
+  void assert_next(char ch) {
+    assert(peek() == ch);
+    next();
+  }
+
+private:
+  iterator iter_;
+  iterator end_;
+};
 }
 
 
@@ -1,13 +1,23 @@
 #ifndef _READER_H_
 #define _READER_H_
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 #include "exception.h"
 #include "value.h"
+#include "stats.h"
+#include "utf8.h"
 
 namespace json2 {
 
@@ -65,18 +75,114 @@ namespace json2 {
  *  EndObject(7)  
  * ```   
  * */
+/**
+ * @description: parse_flag 用于控制 reader 的解析行为，以模板参数的形式传入 reader::parse()，
+ *      可以按位或组合。由于是编译期常量，未开启的功能不会带来任何运行时开销
+ *  - PARSE_FLAG_RAW：转码（transcode）模式。string 和 number 不进行解码和数值转换，
+ *      只做合法性校验，然后以原始字节发送给 handler：
+ *        handle_raw_string(const std::string& raw)  // 两个引号之间的原始内容，转义序列保持原样
+ *        handle_raw_key(const std::string& raw)
+ *        handle_raw_number(std::string_view raw)
+ *      搭配 writer / pretty_writter 即可完成 minify / 重新缩进，并且数字不会有任何精度损失
+ *  - PARSE_FLAG_RAW_NUMBER：只有 number 以原始字节发送（handle_raw_number(std::string_view raw)），
+ *      string 仍然正常解码。number 只做合法性校验，不调用 strtod() 等进行转换；
+ *      document 会将其保存为 TYPE_NUMBER，直到调用 get_int64_value() / get_double_value() 时才转换
+ *      （get_int32_value() / get_int64_value() 只接受范围内的整数，见 value::is_raw_integer()），
+ *      因此只转发数字的场景没有任何转换的开销，超出 double 精度的数字也可以原样写回
+ *  - PARSE_FLAG_VALIDATE_UTF8：在解析 string / key 的同时校验其中的非 ASCII 字节是否为合法的 UTF-8
+ *      （见 utf8.h），不合法时返回 PARSE_BAD_UTF8。ASCII 字节不受影响，因此额外的开销只与非 ASCII
+ *      字节的个数有关，也不需要单独对整个输入做一遍校验。被 skip_next_value() 跳过的 value 不做校验
+ */
+enum parse_flag {
+  PARSE_FLAG_DEFAULT = 0,
+  PARSE_FLAG_RAW = 1 << 0,
+  PARSE_FLAG_VALIDATE_UTF8 = 1 << 1,
+  PARSE_FLAG_RAW_NUMBER = 1 << 2,
+};
+
+/**
+ * @description: reader_context 保存解析过程中使用的临时 buffer。
+ *      reader::parse() 每次调用都会创建一个新的 reader_context；而通过 parser（或直接向
+ *      reader::parse() 传入同一个 reader_context）反复解析时，这些 buffer 的容量会被保留下来，
+ *      解析大量小 json 时，reader 本身可以达到不再分配内存的稳定状态
+ *
+ *  max_depth_ 限制 array / object 嵌套的层数，超过时返回 PARSE_DEPTH_EXCEEDED，
+ *  用于拒绝不可信输入中恶意构造的深层嵌套
+ */
+struct reader_context {
+public:
+  std::string string_buffer_; // 解码后的 string / key
+  std::string number_buffer_; // 待转换的数字
+  std::vector<char> stack_;   // 当前所在的各层 array / object，'[' 或 '{'
+  size_t max_depth_ = 1024;   // array / object 允许嵌套的最大层数
+#ifdef JSON2_ENABLE_STATS
+  stats stats_;               // 统计信息，见 stats.h
+#endif
+};
+
+template <typename Handler, typename = void>
+struct has_uint64_handler : std::false_type {};
+
+template <typename Handler>
+struct has_uint64_handler<Handler, 
+    std::void_t<decltype(std::declval<Handler&>().handle_uint64(uint64_t()))>> : 
+  std::true_type {};
+
+// handle_uint64() 是可选的事件：超出 int64_t 范围的正整数发送给 handle_uint64()，
+// handler 没有实现 handle_uint64() 时退化为 handle_double()（可能损失精度）
+template <typename Handler>
+bool dispatch_uint64(Handler& handler, uint64_t val) {
+  if constexpr (has_uint64_handler<Handler>::value)
+    return handler.handle_uint64(val);
+  else
+    return handler.handle_double(static_cast<double>(val));
+}
+
+/**
+ * @description: handler 可以选择性地提供以下成员函数，用于跳过不需要的 value：
+ *  ```
+ *    bool skip_next_value();
+ *  ```
+ *  reader 在每次调用 handle_key() 之后、以及解析 array 的每个元素之前都会询问 skip_next_value()，
+ *  若返回 true，则该 key 对应的 value 或该元素（可以是整个 array 或 object）会被直接跳过，
+ *  不会产生任何事件。跳过时只匹配引号、转义字符和括号，
+ *  既不解码 string 也不转换数字，因此被跳过的部分只做最基本的结构检查。
+ *  没有提供该函数的 handler 不受任何影响（编译期检测）。
+ */
+template <typename Handler, typename = void>
+struct has_skip_value_handler : std::false_type {};
+
+template <typename Handler>
+struct has_skip_value_handler<Handler, 
+    std::void_t<decltype(std::declval<Handler&>().skip_next_value())>> : 
+  std::true_type {};
+
+template <typename ReadStream, unsigned flags>
+class cursor;
+
 class reader {
+  // cursor 按需调用 reader 中解析单个 value 的函数（见 cursor.h）
+  template <typename ReadStream, unsigned flags>
+  friend class cursor;
+
 public:
   reader(const reader&) = delete;
   reader& operator=(const reader&) = delete;
 
 public:
 
-  template <typename ReadStream, typename Handler>
+  template <unsigned flags = PARSE_FLAG_DEFAULT, typename ReadStream, typename Handler>
   static parse_error parse(ReadStream& stream, Handler& handler) {
+    reader_context ctx;
+    return parse<flags>(stream, handler, ctx);
+  }
+
+  // 使用调用者提供的 ctx 进行解析，ctx 中的 buffer 在多次解析之间会被复用（见 parser）
+  template <unsigned flags = PARSE_FLAG_DEFAULT, typename ReadStream, typename Handler>
+  static parse_error parse(ReadStream& stream, Handler& handler, reader_context& ctx) {
     try {
       parse_whitespace(stream);
-      parse_value(stream, handler);
+      parse_value<flags>(stream, handler, ctx);
       parse_whitespace(stream);
       if(stream.has_next()) {
         throw json_exception(PARSE_ROOT_NOT_SINGULAR);
@@ -87,36 +193,73 @@ public:
     }
   }
 
+  // parse_next() 只解析 stream 中的下一个 value（包括其之前的空白字符），解析完成后 stream 停在
+  // 该 value 之后，并不要求 stream 中只有一个 root，主要用于在同一个 stream 中依次解析多个 value
+  template <unsigned flags = PARSE_FLAG_DEFAULT, typename ReadStream, typename Handler>
+  static parse_error parse_next(ReadStream& stream, Handler& handler) {
+    reader_context ctx;
+    return parse_next<flags>(stream, handler, ctx);
+  }
+
+  template <unsigned flags = PARSE_FLAG_DEFAULT, typename ReadStream, typename Handler>
+  static parse_error parse_next(ReadStream& stream, Handler& handler, reader_context& ctx) {
+    try {
+      parse_whitespace(stream);
+      parse_value<flags>(stream, handler, ctx);
+      return PARSE_OK;
+    } catch(json_exception& e) {
+      return e.error();
+    }
+  }
+
+  // skip() 跳过 stream 中的下一个 value（包括其之前的空白字符），不需要 handler
+  template <typename ReadStream>
+  static parse_error skip(ReadStream& stream) {
+    try {
+      parse_whitespace(stream);
+      skip_value_aux(stream);
+      return PARSE_OK;
+    } catch(json_exception& e) {
+      return e.error();
+    }
+  }
+
 private:
 #define CALL(expr) \
   if(!(expr)) throw json_exception(PARSE_USER_STOPPED)
 
+  // hex_table 将字符映射为对应的 16 进制数值，不是 16 进制数字的字符映射为 -1
+  static constexpr int8_t hex_table[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,   // '0' ~ '9'
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,   // 'A' ~ 'F'
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,   // 'a' ~ 'f'
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+  };
+
   // parse_hex_aux() 函数主要用于 parse Unicode 的辅助函数
-  // 每次 parse 4位
+  // 每次 parse 4位：每一位通过 hex_table 查表得到，只要有一位不是 16 进制数字，
+  // 其结果就是 -1，4 个结果按位或之后为负数，因此只需要在最后判断一次
   template <typename ReadStream>
   static unsigned parse_hex_aux(ReadStream& stream) {
-    unsigned ret = 0;
-    for(int i = 0; i < 4; i++) {
-      // 将结果左移 4 位，将结果存储在之前的 4 位上
-      ret <<= 4;
-      // 遍历输出流的 4 位，然后依次翻译
-      // 由于是按位修改 ret，而且不能改变之前得到的 ret 的值，所以需要使用
-      // 或操作符（|）
-      switch(char ch = stream.next()) {
-        case '0' ... '9':
-          ret |= ch - '0';
-          break;
-        case 'a' ... 'f':
-          ret |= ch - 'a' + 10;
-          break;
-        case 'A' ... 'F':
-          ret |= ch - 'A' + 10;
-          break;
-        default:
-          throw json_exception(PARSE_BAD_UNICODE_HEX);
-      } 
-    }
-    return ret;
+    int digit0 = hex_table[static_cast<unsigned char>(stream.next())];
+    int digit1 = hex_table[static_cast<unsigned char>(stream.next())];
+    int digit2 = hex_table[static_cast<unsigned char>(stream.next())];
+    int digit3 = hex_table[static_cast<unsigned char>(stream.next())];
+    if((digit0 | digit1 | digit2 | digit3) < 0)
+      throw json_exception(PARSE_BAD_UNICODE_HEX);
+    return static_cast<unsigned>((digit0 << 12) | (digit1 << 8) | (digit2 << 4) | digit3);
   }
 
   template <typename ReadStream>
@@ -169,24 +312,33 @@ private:
     throw json_exception(PARSE_BAD_VALUE);
   }
 
-  template <typename ReadStream, typename Handler>
-  static void parse_number(ReadStream& stream, Handler& handler) {
+  template <unsigned flags, typename ReadStream, typename Handler>
+  static void parse_number(ReadStream& stream, Handler& handler, reader_context& ctx) {
     // parse 'NaN' && 'Infinity'
     // float 或者 double 类型都有 NaN
+    // number_nanos_ / string_nanos_ 只统计 reader 本身的耗时，调用 handler 之前先停止计时
+    JSON2_STATS(stats_timer timer(ctx.stats_.number_nanos_));
     if(stream.peek() == 'N') {
+      JSON2_STATS(timer.stop());
       parse_literal_aux(stream, handler, "NaN", TYPE_DOUBLE);
+      JSON2_STATS(ctx.stats_.double_count_++);
       return;
     } else if(stream.peek() == 'I') {
+      JSON2_STATS(timer.stop());
       parse_literal_aux(stream, handler, "Infinity", TYPE_DOUBLE);
+      JSON2_STATS(ctx.stats_.double_count_++);
       return;
     }
 
     auto start = stream.get_iterator();
     // 开始处理数字部分
     // 首先将负号(-)处理掉
-    if(stream.peek() == '-')
+    bool negative = stream.peek() == '-';
+    if(negative)
       stream.next();
     
+    // 记录整数部分的起止位置，整数的数值直接由这一段数字计算，见 parse_integer_aux()
+    auto digits = stream.get_iterator();
     // 如果一个数字以 lead-zero 开头，
     if(stream.peek() == '0') {
       stream.next();
@@ -198,6 +350,7 @@ private:
         stream.next();
     } else 
       throw json_exception(PARSE_BAD_VALUE);
+    size_t digit_count = stream.get_iterator() - digits;
 
     auto expect_type = TYPE_NULL;
   
@@ -207,7 +360,9 @@ private:
       expect_type = TYPE_DOUBLE;
       stream.next();
       if(!is_digit(stream.peek()))
-        stream.next(); 
+        throw json_exception(PARSE_BAD_VALUE);
+      while(is_digit(stream.peek()))
+        stream.next();
     }
     
     // 主要处理以下这种形式的浮点数:123e-2 或者 123.45e-4
@@ -251,53 +406,156 @@ private:
     if(start == end)
       throw json_exception(PARSE_BAD_VALUE);
 
+    // 转码模式下，直接将数字的原始字节发送给 handler
+    // 原始字节放在复用的 ctx.number_buffer_ 中，不需要每个数字分配一次内存
+    if constexpr ((flags & (PARSE_FLAG_RAW | PARSE_FLAG_RAW_NUMBER)) != 0) {
+      JSON2_STATS(ctx.stats_.raw_number_count_++);
+      JSON2_STATS(size_t capacity = ctx.number_buffer_.capacity());
+      ctx.number_buffer_.assign(&*start, end - start);
+      JSON2_STATS(ctx.stats_.reader_buffer_growths_ += ctx.number_buffer_.capacity() != capacity);
+      JSON2_STATS(timer.stop());
+      CALL(handler.handle_raw_number(std::string_view(ctx.number_buffer_)));
+      return;
+    }
+
+    // 整数不需要拷贝，也不需要调用 strtol()：数字是连续存储的，直接在整数部分上计算数值
+    if(expect_type != TYPE_DOUBLE) {
+      parse_integer_aux(handler, ctx, &*digits, digit_count, negative, expect_type, [&] {
+        JSON2_STATS(timer.stop());
+      });
+      return;
+    }
+
     // 上面的的判断过程结束后，就需要将字符串形式的数字转换为数字形式
+    // 先将数字拷贝到 ctx.number_buffer_ 中，保证 strtod() 等函数不会读到 end 之后的内容
+    // 所有的 stream 都是连续存储的，以指针和长度拷贝，避免通用迭代器版本的 assign() 先构造一个临时 string
+    JSON2_STATS(size_t capacity = ctx.number_buffer_.capacity());
+    ctx.number_buffer_.assign(&*start, end - start);
+    JSON2_STATS(ctx.stats_.reader_buffer_growths_ += ctx.number_buffer_.capacity() != capacity);
+    const char* str = ctx.number_buffer_.c_str();
+    double val;
     try {
       std::size_t idx;
-      if(expect_type == TYPE_DOUBLE) {
-        double val = __gnu_cxx::__stoa(&std::strtod, "stod", &*start, &idx);
-        assert(start + idx == end);
-        CALL(handler.handle_double(val));
-      } else {
-        int64_t val = __gnu_cxx::__stoa(&std::strtol, "stol", &*start, &idx, 10);
-        if(expect_type == TYPE_INT64) {
-          CALL(handler.handle_int64(val)); 
-        } else if (expect_type == TYPE_INT32) {
-          // 排除超出 int32_t 范围数字
-          if(val > std::numeric_limits<int32_t>::max() ||
-             val < std::numeric_limits<int32_t>::min()) {
-            throw std::out_of_range("int32_t overflow");
-          }
-          CALL(handler.handle_int32(static_cast<int32_t>(val)));
-        } else if(val > std::numeric_limits<int32_t>::max() ||
-                  val < std::numeric_limits<int32_t>::min()) {
-          // 这么做的原因：也许在上面的步骤中，有不满足上述要求的数值，即 expect_type 可以为 TYPE_NULL，但
-          // 其却是数字
-          CALL(handler.handle_int32(static_cast<int32_t>(val)));
-        } else {
-          CALL(handler.handle_int64(val)); 
-        }
-      }
+      val = __gnu_cxx::__stoa(&std::strtod, "stod", str, &idx);
+      assert(idx == ctx.number_buffer_.size());
     } catch(std::out_of_range& e) {
       throw json_exception(PARSE_NUMBER_TOO_BIG); 
     }
+    JSON2_STATS(ctx.stats_.double_count_++);
+    JSON2_STATS(timer.stop());
+    CALL(handler.handle_double(val));
   }
 
-  template <typename ReadStream, typename Handler>
-  static void parse_string(ReadStream& stream, Handler& handler, bool is_key) {
+  // parse_eight_digits_aux() 使用 SWAR（SIMD within a register）一次转换 8 个十进制数字：
+  // 将 8 个字符读入一个 uint64_t 并减去 '0'，然后每一步将相邻的两组合并为一组，
+  // 3 次乘法后得到数值（相邻的 1 位 -> 2 位 -> 4 位 -> 8 位）
+  static uint32_t parse_eight_digits_aux(const char* str) {
+    uint64_t val;
+    memcpy(&val, str, sizeof(val));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    // 保证第 1 个数字位于最低的字节
+    val = __builtin_bswap64(val);
+#endif
+    val -= 0x3030303030303030ULL;
+    val = (val * 10 + (val >> 8)) & 0x00FF00FF00FF00FFULL;
+    val = (val * 100 + (val >> 16)) & 0x0000FFFF0000FFFFULL;
+    val = (val * 10000 + (val >> 32)) & 0x00000000FFFFFFFFULL;
+    return static_cast<uint32_t>(val);
+  }
+
+  // 将 [str, str + length) 中的十进制数字转换为 val，超出 uint64_t 的范围时返回 false
+  static bool parse_digits_aux(const char* str, size_t length, uint64_t& val) {
+    // uint64_t 的最大值 18446744073709551615 共 20 位，19 位以内的数字一定不会溢出
+    if(length > 20)
+      return false;
+    size_t safe_length = std::min<size_t>(length, 19);
+    size_t i = 0;
+    val = 0;
+    for(; i + 8 <= safe_length; i += 8)
+      val = val * 100000000 + parse_eight_digits_aux(str + i);
+    for(; i < safe_length; i++)
+      val = val * 10 + static_cast<unsigned>(str[i] - '0');
+    if(length == 20) {
+      unsigned digit = static_cast<unsigned>(str[19] - '0');
+      if(val > (std::numeric_limits<uint64_t>::max() - digit) / 10)
+        return false;
+      val = val * 10 + digit;
+    }
+    return true;
+  }
+
+  // parse_integer_aux() 根据数值的范围选择事件：
+  //  - int32_t 范围内的整数发送 handle_int32()
+  //  - int64_t 范围内的整数发送 handle_int64()
+  //  - 超出 int64_t 但在 uint64_t 范围内的正整数发送 handle_uint64()（见 dispatch_uint64()）
+  // 带有后缀 i32 / i64 的整数只能发送对应的事件，超出其范围时与超出 uint64_t 一样返回 PARSE_NUMBER_TOO_BIG
+  // stop_timer 在调用 handler 之前调用（见 parse_number() 中的 number_nanos_）
+  template <typename Handler, typename StopTimer>
+  static void parse_integer_aux(Handler& handler, [[maybe_unused]] reader_context& ctx,
+                                const char* digits, size_t digit_count, bool negative,
+                                value_type expect_type, StopTimer stop_timer) {
+    uint64_t magnitude;
+    if(!parse_digits_aux(digits, digit_count, magnitude))
+      throw json_exception(PARSE_NUMBER_TOO_BIG);
+    // 负数的绝对值可以比正数的最大值大 1，如 -2147483648
+    uint64_t int32_limit = static_cast<uint64_t>(std::numeric_limits<int32_t>::max()) + negative;
+    uint64_t int64_limit = static_cast<uint64_t>(std::numeric_limits<int64_t>::max()) + negative;
+    if(expect_type == TYPE_INT32 && magnitude > int32_limit)
+      throw json_exception(PARSE_NUMBER_TOO_BIG);
+    if(magnitude > int64_limit) {
+      if(negative || expect_type == TYPE_INT64)
+        throw json_exception(PARSE_NUMBER_TOO_BIG);
+      JSON2_STATS(ctx.stats_.uint64_count_++);
+      stop_timer();
+      CALL(dispatch_uint64(handler, magnitude));
+      return;
+    }
+    // 在 uint64_t 上取反，避免 -9223372036854775808 在 int64_t 上溢出
+    int64_t val = static_cast<int64_t>(negative ? 0 - magnitude : magnitude);
+    stop_timer();
+    if(expect_type != TYPE_INT64 && magnitude <= int32_limit) {
+      JSON2_STATS(ctx.stats_.int32_count_++);
+      CALL(handler.handle_int32(static_cast<int32_t>(val)));
+    } else {
+      JSON2_STATS(ctx.stats_.int64_count_++);
+      CALL(handler.handle_int64(val)); 
+    }
+  }
+
+  template <unsigned flags, typename ReadStream, typename Handler>
+  static void parse_string(ReadStream& stream, Handler& handler, reader_context& ctx, bool is_key) {
     // 如果为 string 形式，则一定以 "" 开始和结尾 
     // 故现在此处进行对 string 的起始进行一个预判断
     // 如果确实是以 " 开头，可初步判断为 string，并将指针后移 
+    JSON2_STATS(stats_timer timer(ctx.stats_.string_nanos_));
+    JSON2_STATS(size_t capacity = ctx.string_buffer_.capacity());
+    if constexpr ((flags & PARSE_FLAG_RAW) != 0) {
+      scan_string_aux<flags>(stream, ctx.string_buffer_);
+      JSON2_STATS(count_string_aux(ctx, is_key, ctx.string_buffer_.find('\\') != std::string::npos, capacity));
+      JSON2_STATS(timer.stop());
+      if(is_key) {
+        CALL(handler.handle_raw_key(ctx.string_buffer_));
+      } else {
+        CALL(handler.handle_raw_string(ctx.string_buffer_));
+      }
+      return;
+    }
+
     stream.assert_next('"');
-    std::string buffer;
+    // 解码后的内容先写入 ctx.string_buffer_，其容量在多次解析之间保留
+    std::string& buffer = ctx.string_buffer_;
+    buffer.clear();
+    JSON2_STATS(bool escaped = false);
     while(stream.has_next()) {
       switch(char ch = stream.next()) {
         case '"':
+          JSON2_STATS(count_string_aux(ctx, is_key, escaped, capacity));
+          JSON2_STATS(timer.stop());
           // 有可能是 "" 这种形式的string，其甚至可能是一个 key
           if(is_key) {
-            CALL(handler.handle_key(std::move(buffer)));
+            CALL(handler.handle_key(buffer));
           } else {
-            CALL(handler.handle_string(std::move(buffer)));
+            CALL(handler.handle_string(buffer));
           }
           return;
         /*
@@ -310,6 +568,7 @@ private:
           // 由于 0~31 这些都是控制字符，为不可见字符，所以不应该出现在 string 之中
           throw json_exception(PARSE_BAD_STRING_CHAR);
         case '\\':
+          JSON2_STATS(escaped = true);
           // 如果为正确的 string，其形式应该为：\uD1ef
           switch(stream.next()) {
             case '"':
@@ -317,7 +576,7 @@ private:
             case '\\': 
               buffer.push_back('\\');  break;
             case '/': 
-              buffer.push_back('\\');  break;
+              buffer.push_back('/');  break;
             case 'b': 
               buffer.push_back('\b');  break;
             case 'f': 
@@ -330,8 +589,8 @@ private:
               buffer.push_back('\t');  break;
             case 'u': {
               // 如果是类似 \u123d 这种形式，便是 Unicode 形式
-              unsigned high_surrogate = parse_hex_aux(stream);
-              if(high_surrogate >= 0xD800 && high_surrogate <= 0xDBFF) {
+              unsigned code = parse_hex_aux(stream);
+              if(code >= 0xD800 && code <= 0xDBFF) {
                 /* unicode 理解
                  *  1. Unicode
                  *    我们知道 ASCII，它是一种字符编码，把 128 个字符映射至整数 0 ~ 127。
@@ -427,124 +686,303 @@ private:
                  *    }
                  *  ```
                  */
-                  int val = 0;
                   if(stream.next() != '\\')
                     // 因为对于高代理项而言，应是这种形式:\uXXXX\uYYYY  
                     throw json_exception(PARSE_BAD_UNICODE_SURROGATE);
                   if(stream.next() != 'u')
                     throw json_exception(PARSE_BAD_UNICODE_SURROGATE);
                   
-                  unsigned high_surrogate = parse_hex_aux(stream);
-                  if(high_surrogate >= 0xDC00 && high_surrogate <= 0xDFFF) {
-                    val = 0x10000 + (high_surrogate - 0xD800) * 0x400 + (high_surrogate - 0xDC00);
-                  } else {
+                  unsigned low_surrogate = parse_hex_aux(stream);
+                  if(low_surrogate < 0xDC00 || low_surrogate > 0xDFFF)
                     throw json_exception(PARSE_BAD_UNICODE_SURROGATE);
-                  }
-                  
-                  encode_utf8(buffer, val);
-                  break;
-              } 
-            } default:
-                throw json_exception(PARSE_BAD_STRING_ESCAPE);
+                  code = 0x10000 + ((code - 0xD800) << 10) + (low_surrogate - 0xDC00);
+              } else if(code >= 0xDC00 && code <= 0xDFFF) {
+                // 低代理项不能单独出现
+                throw json_exception(PARSE_BAD_UNICODE_SURROGATE);
+              }
+              encode_utf8(buffer, code);
+              break;
+            }
+            default:
+              throw json_exception(PARSE_BAD_STRING_ESCAPE);
           }
           break;
         default:
           buffer.push_back(ch);
+          if constexpr ((flags & PARSE_FLAG_VALIDATE_UTF8) != 0) {
+            if(static_cast<unsigned char>(ch) >= 0x80)
+              check_utf8_aux(stream, static_cast<unsigned char>(ch), &buffer);
+          }
       }
     } 
     throw json_exception(PARSE_MISS_QUOTATION_MARK);
   }
 
-  template <typename ReadStream, typename Handler>
-  static void parse_value(ReadStream& stream, Handler& handler) {
-    if(!stream.has_next())  
-      throw json_exception(PARSE_EXPECT_VALUE);
-    switch(stream.peek()) {
-      case 'n': 
-        return parse_literal_aux(stream, handler, "null", TYPE_NULL);
-      case 't': 
-        return parse_literal_aux(stream, handler, "true", TYPE_BOOL);
-      case 'f': 
-        return parse_literal_aux(stream, handler, "false", TYPE_BOOL);
-      case '"': 
-        return parse_string(stream, handler, false);
-      case '[': 
-        return parse_array(stream, handler);
-      case '{': 
-        return parse_object(stream, handler);
-      default:
-        return parse_number(stream, handler); 
+  // scan_string_aux() 只校验 string 的合法性（控制字符、转义序列、代理对），而不进行解码，
+  // 并将两个引号之间的原始字节写入 buffer
+  template <unsigned flags, typename ReadStream>
+  static void scan_string_aux(ReadStream& stream, std::string& buffer) {
+    stream.assert_next('"');
+    auto start = stream.get_iterator();
+    while(stream.has_next()) {
+      switch(char ch = stream.next()) {
+        case '"':
+          buffer.assign(&*start, stream.get_iterator() - 1 - start);
+          return;
+        case '\x01'...'\x1f':
+          throw json_exception(PARSE_BAD_STRING_CHAR);
+        case '\\':
+          switch(stream.next()) {
+            case '"': case '\\': case '/': 
+            case 'b': case 'f': case 'n': case 'r': case 't':
+              break;
+            case 'u': {
+              unsigned code = parse_hex_aux(stream);
+              if(code >= 0xD800 && code <= 0xDBFF) {
+                // 高代理项之后必须紧跟一个低代理项
+                if(stream.next() != '\\' || stream.next() != 'u')
+                  throw json_exception(PARSE_BAD_UNICODE_SURROGATE);
+                unsigned low = parse_hex_aux(stream);
+                if(low < 0xDC00 || low > 0xDFFF)
+                  throw json_exception(PARSE_BAD_UNICODE_SURROGATE);
+              } else if(code >= 0xDC00 && code <= 0xDFFF) {
+                throw json_exception(PARSE_BAD_UNICODE_SURROGATE);
+              }
+              break;
+            }
+            default:
+              throw json_exception(PARSE_BAD_STRING_ESCAPE);
+          }
+          break;
+        case '\x80'...'\xff':
+          if constexpr ((flags & PARSE_FLAG_VALIDATE_UTF8) != 0)
+            check_utf8_aux(stream, static_cast<unsigned char>(ch), nullptr);
+          break;
+        default:
+          break;
+      }
     }
+    throw json_exception(PARSE_MISS_QUOTATION_MARK);
   }
 
-  template <typename ReadStream, typename Handler>
-  static void parse_array(ReadStream& stream, Handler& handler) {
-    CALL(handler.handle_start_array());
-    stream.assert_next('['); 
-    parse_whitespace(stream);
-    // 处理空 array 
-    if(stream.peek() == ']') {
+  // 首字节 lead 已经读出（并已写入 buffer），校验并读出其后续字节，buffer 不为空时将后续字节写入 buffer
+  template <typename ReadStream>
+  static void check_utf8_aux(ReadStream& stream, unsigned char lead, std::string* buffer) {
+    unsigned char low, high;
+    unsigned count = utf8_trail_count(lead, low, high);
+    if(count == 0)
+      throw json_exception(PARSE_BAD_UTF8);
+    for(unsigned i = 0; i < count; i++) {
+      auto ch = static_cast<unsigned char>(stream.peek());
+      if(!stream.has_next() || ch < low || ch > high)
+        throw json_exception(PARSE_BAD_UTF8);
       stream.next();
-      CALL(handler.handle_end_array());
+      if(buffer != nullptr)
+        buffer->push_back(static_cast<char>(ch));
+      low = 0x80;
+      high = 0xBF;
+    }
+  }
+
+  template <typename ReadStream>
+  static void skip_string_aux(ReadStream& stream) {
+    stream.assert_next('"');
+    while(stream.has_next()) {
+      char ch = stream.next();
+      if(ch == '"')
+        return;
+      if(ch == '\\')
+        stream.next();
+    }
+    throw json_exception(PARSE_MISS_QUOTATION_MARK);
+  }
+
+  // skip_value_aux() 跳过一个 value：string 只匹配引号和转义字符，array 和 object 只匹配括号，
+  // 其他 value（数字和字面常量）则一直跳到下一个分隔符
+  template <typename ReadStream>
+  static void skip_value_aux(ReadStream& stream) {
+    if(!stream.has_next())
+      throw json_exception(PARSE_EXPECT_VALUE);
+    char open = stream.peek();
+    if(open == '"') {
+      skip_string_aux(stream);
+      return;
+    }
+    if(open != '[' && open != '{') {
+      bool empty = true;
+      while(stream.has_next()) {
+        char ch = stream.peek();
+        if(ch == ',' || ch == ']' || ch == '}' || 
+           ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n')
+          break;
+        stream.next();
+        empty = false;
+      }
+      if(empty)
+        throw json_exception(PARSE_EXPECT_VALUE);
       return;
     }
 
-    while(true) {
-      parse_value(stream, handler);
-      parse_whitespace(stream);
-      switch(stream.next()) {
-        case ',':
-          // 如果遇到 , 说明 array 中还有其他项，需要继续往后 parse 
-          parse_whitespace(stream);
+    int depth = 0;
+    while(stream.has_next()) {
+      switch(stream.peek()) {
+        case '"':
+          skip_string_aux(stream);
+          continue;
+        case '[':
+        case '{':
+          depth++;
           break;
         case ']':
-          CALL(handler.handle_end_array());
-          return;
+        case '}':
+          if(--depth == 0) {
+            stream.next();
+            return;
+          }
+          break;
         default:
-          throw json_exception(PARSE_MISS_COMMA_OR_SQUARE_BRACKET);
+          break;
       }
+      stream.next();
     }
+    throw json_exception(open == '[' ? PARSE_MISS_COMMA_OR_SQUARE_BRACKET 
+                                     : PARSE_MISS_COMMA_OR_CURLY_BRACKET);
   }
 
-  template <typename ReadStream, typename Handler>
-  static void parse_object(ReadStream& stream, Handler& handler) {
-    CALL(handler.handle_start_object());
-    stream.assert_next('{');
-    parse_whitespace(stream);
-    // 用于处理空 object 
-    if(stream.peek() == '}') {
-      stream.next();
-      CALL(handler.handle_end_object());
-      return;
+  // parse_value() 以迭代的方式解析一个 value：当前所在的各层 array / object 以 '[' / '{' 的形式
+  // 保存在 ctx.stack_ 中，而不是占用 C++ 的调用栈，因此恶意构造的深层嵌套输入不会导致栈溢出，
+  // 嵌套层数超过 ctx.max_depth_ 时抛出 PARSE_DEPTH_EXCEEDED
+  template <unsigned flags, typename ReadStream, typename Handler>
+  static void parse_value(ReadStream& stream, Handler& handler, reader_context& ctx) {
+    auto& stack = ctx.stack_;
+    stack.clear();
+    JSON2_STATS(auto first = stream.get_iterator());
+    JSON2_STATS(size_t capacity = stack.capacity());
+    while(true) {
+      // 解析一个 value，若其为非空的 array / object，则进入其中并继续解析第一个元素
+      if(open_value_aux<flags>(stream, handler, ctx) && enter_member_aux<flags>(stream, handler, ctx))
+        continue;
+
+      // 当前 value 已经结束，处理其后的 ',' 或者所在的 array / object 的结束
+      while(true) {
+        if(stack.empty()) {
+          JSON2_STATS(ctx.stats_.bytes_ += stream.get_iterator() - first);
+          JSON2_STATS(ctx.stats_.reader_buffer_growths_ += stack.capacity() != capacity);
+          return;
+        }
+        parse_whitespace(stream);
+        bool in_array = stack.back() == '[';
+        char ch = stream.next();
+        if(ch == ',') {
+          parse_whitespace(stream);
+          if(enter_member_aux<flags>(stream, handler, ctx))
+            break;
+        } else if(in_array && ch == ']') {
+          stack.pop_back();
+          CALL(handler.handle_end_array());
+        } else if(!in_array && ch == '}') {
+          stack.pop_back();
+          CALL(handler.handle_end_object());
+        } else {
+          throw json_exception(in_array ? PARSE_MISS_COMMA_OR_SQUARE_BRACKET
+                                        : PARSE_MISS_COMMA_OR_CURLY_BRACKET);
+        }
+      }
     }
+  }
 
-    while(true) {
+  // 解析一个 value 的开始：对于 string、数字等 value 以及空的 array / object，直接解析完整个 value
+  // 并返回 false；对于非空的 array / object，将其压入 ctx.stack_ 并返回 true
+  template <unsigned flags, typename ReadStream, typename Handler>
+  static bool open_value_aux(ReadStream& stream, Handler& handler, reader_context& ctx) {
+    if(!stream.has_next())  
+      throw json_exception(PARSE_EXPECT_VALUE);
+    switch(stream.peek()) {
+      case 'n': 
+        parse_literal_aux(stream, handler, "null", TYPE_NULL);
+        JSON2_STATS(ctx.stats_.null_count_++);
+        return false;
+      case 't': 
+        parse_literal_aux(stream, handler, "true", TYPE_BOOL);
+        JSON2_STATS(ctx.stats_.bool_count_++);
+        return false;
+      case 'f': 
+        parse_literal_aux(stream, handler, "false", TYPE_BOOL);
+        JSON2_STATS(ctx.stats_.bool_count_++);
+        return false;
+      case '"': 
+        parse_string<flags>(stream, handler, ctx, false);
+        return false;
+      case '[': 
+        check_depth_aux(ctx);
+        JSON2_STATS(ctx.stats_.array_count_++);
+        JSON2_STATS(ctx.stats_.max_depth_ = std::max(ctx.stats_.max_depth_, ctx.stack_.size() + 1));
+        CALL(handler.handle_start_array());
+        stream.next();
+        parse_whitespace(stream);
+        // 处理空 array 
+        if(stream.peek() == ']') {
+          stream.next();
+          CALL(handler.handle_end_array());
+          return false;
+        }
+        ctx.stack_.push_back('[');
+        return true;
+      case '{': 
+        check_depth_aux(ctx);
+        JSON2_STATS(ctx.stats_.object_count_++);
+        JSON2_STATS(ctx.stats_.max_depth_ = std::max(ctx.stats_.max_depth_, ctx.stack_.size() + 1));
+        CALL(handler.handle_start_object());
+        stream.next();
+        parse_whitespace(stream);
+        // 处理空 object 
+        if(stream.peek() == '}') {
+          stream.next();
+          CALL(handler.handle_end_object());
+          return false;
+        }
+        ctx.stack_.push_back('{');
+        return true;
+      default:
+        parse_number<flags>(stream, handler, ctx); 
+        return false;
+    }
+  }
+
+#ifdef JSON2_ENABLE_STATS
+  static void count_string_aux(reader_context& ctx, bool is_key, bool escaped, size_t capacity) {
+    (is_key ? ctx.stats_.key_count_ : ctx.stats_.string_count_)++;
+    (escaped ? ctx.stats_.escaped_string_count_ : ctx.stats_.plain_string_count_)++;
+    ctx.stats_.reader_buffer_growths_ += ctx.string_buffer_.capacity() != capacity;
+  }
+#endif
+
+  static void check_depth_aux(reader_context& ctx) {
+    if(ctx.stack_.size() >= ctx.max_depth_)
+      throw json_exception(PARSE_DEPTH_EXCEEDED);
+  }
+
+  // 进入 array 的下一个元素或 object 的下一个成员（object 需要先解析 key 和 ':'），
+  // handler 可以通过 skip_next_value() 跳过它，此时返回 false
+  template <unsigned flags, typename ReadStream, typename Handler>
+  static bool enter_member_aux(ReadStream& stream, Handler& handler, reader_context& ctx) {
+    if(ctx.stack_.back() == '{') {
+      // object 的 key 的类型必须为 string
       if(stream.peek() != '"')
-        // object 的 key 的类型必须为 string
         throw json_exception(PARSE_MISS_KEY);
-      // parse key      
-      parse_string(stream, handler, true);
-
-      // parse ':'
+      parse_string<flags>(stream, handler, ctx, true);
       parse_whitespace(stream);
       if(stream.next() != ':')
         throw json_exception(PARSE_MISS_COLON);
-
-      // parse value
-      parse_whitespace(stream);
-      parse_value(stream, handler);
       parse_whitespace(stream);
-      switch(stream.next()) {
-        case ',':
-          parse_whitespace(stream);
-          break;
-        case '}':
-          CALL(handler.handle_end_object());
-          return;
-        default:
-          throw json_exception(PARSE_MISS_COMMA_OR_CURLY_BRACKET);
+    }
+    if constexpr (has_skip_value_handler<Handler>::value) {
+      if(handler.skip_next_value()) {
+        skip_value_aux(stream);
+        return false;
       }
     }
+    return true;
   }
 #undef CALL 
 
@@ -566,38 +1004,81 @@ private:
   // 	U+0800 ~ U+FFFF	   16	    	1110xxxx    10xxxxxx     10xxxxxx
   // 	U+10000 ~ U+10FFFF 21	    	11110xxx    10xxxxxx     10xxxxxx    10xxxxxx  
 
+  // 先将编码得到的 1 ~ 4 个字节写入 bytes，再一次性 append 到 buffer 中
   static void encode_utf8(std::string& buffer, unsigned val) {
-    switch(val) {
-      case 0x00 ... 0x7F:
-        buffer.push_back(val & 0xFF); 
-        break;
-     
-         //0xC0 ===> 1100 0000
-			   //0x80 ===> 1000 0000
-			   //0x3F ===> 0011 1111
-           
-			   //U+0080 ~ U+07FF 
-      case 0x080 ... 0x7FF:
-        buffer.push_back(0xC0 | ((val >> 6) & 0xFF));
-        buffer.push_back(0x80 | (val & 0x3F));
-        break;
-      case  0x0800 ... 0xFFFF:
-        buffer.push_back(0xE0 | ((val >> 12) & 0xFF));
-        buffer.push_back(0x80 | ((val >> 6) & 0x3F));
-        buffer.push_back(0x80 | (val & 0x3F));
-        break;
-      case 0x010000 ... 0x10FFFF:
-        buffer.push_back(0xF0 | ((val >> 18) & 0xFF));
-        buffer.push_back(0x80 | ((val >> 12) & 0x3F));
-        buffer.push_back(0x80 | ((val >> 6) & 0x3F));
-        buffer.push_back(0x80 | (val & 0x3F));
-        break;
-      default:
-        assert(false && "out of range"); 
+    char bytes[4];
+    size_t length;
+    if(val <= 0x7F) {
+      bytes[0] = val;
+      length = 1;
+    } else if(val <= 0x7FF) {
+      //0xC0 ===> 1100 0000
+      //0x80 ===> 1000 0000
+      //0x3F ===> 0011 1111
+      bytes[0] = 0xC0 | (val >> 6);
+      bytes[1] = 0x80 | (val & 0x3F);
+      length = 2;
+    } else if(val <= 0xFFFF) {
+      bytes[0] = 0xE0 | (val >> 12);
+      bytes[1] = 0x80 | ((val >> 6) & 0x3F);
+      bytes[2] = 0x80 | (val & 0x3F);
+      length = 3;
+    } else {
+      assert(val <= 0x10FFFF && "out of range");
+      bytes[0] = 0xF0 | (val >> 18);
+      bytes[1] = 0x80 | ((val >> 12) & 0x3F);
+      bytes[2] = 0x80 | ((val >> 6) & 0x3F);
+      bytes[3] = 0x80 | (val & 0x3F);
+      length = 4;
     }
+    buffer.append(bytes, length);
   }
 #pragma GCC diagnostic pop
 };
 
+/**
+ * @description: parser 是可以实例化的 reader，它持有一个 reader_context，
+ *      因此同一个 parser 反复解析时会复用其中的 buffer。
+ *
+ *  e.g.
+ *  ```
+ *    parser p;
+ *    for(auto& body : bodies) {
+ *      string_read_stream in(body);
+ *      p.parse(in, handler);
+ *    }
+ *  ```
+ */
+class parser {
+public:
+  parser() = default;
+  parser(const parser&) = delete;
+  parser& operator=(const parser&) = delete;
+
+  template <unsigned flags = PARSE_FLAG_DEFAULT, typename ReadStream, typename Handler>
+  parse_error parse(ReadStream& stream, Handler& handler) {
+    return reader::parse<flags>(stream, handler, context_);
+  }
+
+  template <unsigned flags = PARSE_FLAG_DEFAULT, typename ReadStream, typename Handler>
+  parse_error parse_next(ReadStream& stream, Handler& handler) {
+    return reader::parse_next<flags>(stream, handler, context_);
+  }
+
+  // 见 reader_context::max_depth_
+  void set_max_depth(size_t max_depth) {
+    context_.max_depth_ = max_depth;
+  }
+
+#ifdef JSON2_ENABLE_STATS
+  stats& get_stats() {
+    return context_.stats_;
+  }
+#endif
+
+private:
+  reader_context context_;
+};
+
 }
 #endif
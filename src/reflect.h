@@ -0,0 +1,450 @@
+#ifndef _REFLECT_H_
+#define _REFLECT_H_
+
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "exception.h"
+#include "value.h"
+#include "reader.h"
+#include "key_matcher.h"
+
+namespace json2 {
+
+/**
+ * @description: reflect<T> 描述一个 struct 的所有字段，通过 JSON2_REFLECT 宏生成：
+ *  ```
+ *    struct user {
+ *      int64_t id;
+ *      std::string name;
+ *      std::vector<double> scores;
+ *    };
+ *    JSON2_REFLECT(user, id, name, scores)   // 必须写在全局命名空间中
+ *
+ *    user u;
+ *    parse_error err = parse_struct(stream, u);  // json -> struct，不经过 value
+ *    write_struct(writer, u);                    // struct -> json，不经过 value
+ *  ```
+ *  字段的类型可以是：bool、整数、浮点数、std::string、std::vector<U>，以及同样通过
+ *  JSON2_REFLECT 描述的 struct。
+ *
+ *  解析时：
+ *    - key 通过编译期构建的 key_matcher 查找对应的字段（见 key_matcher.h）；
+ *    - 未描述的 key 会通过 skip_next_value() 直接跳过；
+ *    - null 表示保留字段原来的值；
+ *    - 类型不符（例如 string 写入整数字段、整数超出字段类型的范围）时返回 PARSE_TYPE_MISMATCH。
+ */
+template <typename T>
+struct reflect {
+  static constexpr bool defined = false;
+};
+
+// field 表示 struct 中的一个字段：字段名以及成员指针
+template <typename T, typename M>
+struct field {
+public:
+  constexpr field(const char* name, M T::* member) :
+    name_(name),
+    length_(std::char_traits<char>::length(name)),
+    member_(member) {}
+
+public:
+  const char* name_;
+  size_t length_;
+  M T::* member_;
+};
+
+template <typename T, typename M>
+constexpr field<T, M> make_field(const char* name, M T::* member) {
+  return field<T, M>(name, member);
+}
+
+template <typename T>
+struct is_vector : std::false_type {};
+
+template <typename T, typename Alloc>
+struct is_vector<std::vector<T, Alloc>> : std::true_type {};
+
+/**
+ * @description: type_ops 是在编译期为每个类型生成的一组函数指针，struct_handler 在运行时只需要
+ *      根据当前位置的 type_ops 调用即可，不需要任何虚函数或运行时类型信息。
+ *      每个函数返回 false 表示类型不符。
+ */
+struct type_ops {
+  enum kind_type { SCALAR, ARRAY, OBJECT };
+
+  kind_type kind_;
+  bool (*set_bool_)(void* obj, bool val);
+  bool (*set_int64_)(void* obj, int64_t val);
+  bool (*set_uint64_)(void* obj, uint64_t val);
+  bool (*set_double_)(void* obj, double val);
+  bool (*set_string_)(void* obj, const std::string& val);
+  // array：清空容器；追加一个元素，返回其地址，并通过 ops 返回元素的 type_ops
+  void (*clear_)(void* obj);
+  void* (*append_)(void* obj, const type_ops** ops);
+  // object：根据 key 返回对应字段的地址，未描述的 key 返回 nullptr
+  void* (*find_field_)(void* obj, const std::string& key, const type_ops** ops);
+};
+
+template <typename T>
+const type_ops* get_type_ops();
+
+template <typename T>
+struct type_ops_impl {
+  static bool set_bool(void* obj, bool val) {
+    if constexpr (std::is_same<T, bool>::value) {
+      *static_cast<T*>(obj) = val;
+      return true;
+    }
+    return false;
+  }
+
+  static bool set_int64(void* obj, int64_t val) {
+    if constexpr (std::is_same<T, bool>::value) {
+      return false;
+    } else if constexpr (std::is_integral<T>::value) {
+      // 超出字段类型范围的整数视为类型不符
+      if constexpr (std::is_unsigned<T>::value) {
+        if(val < 0 || static_cast<uint64_t>(val) > std::numeric_limits<T>::max())
+          return false;
+      } else {
+        if(val < std::numeric_limits<T>::min() || val > std::numeric_limits<T>::max())
+          return false;
+      }
+      *static_cast<T*>(obj) = static_cast<T>(val);
+      return true;
+    } else if constexpr (std::is_floating_point<T>::value) {
+      *static_cast<T*>(obj) = static_cast<T>(val);
+      return true;
+    }
+    return false;
+  }
+
+  // 超出 int64_t 范围的正整数（见 dispatch_uint64()）
+  static bool set_uint64(void* obj, uint64_t val) {
+    if constexpr (std::is_same<T, bool>::value) {
+      return false;
+    } else if constexpr (std::is_integral<T>::value) {
+      if(val > static_cast<std::make_unsigned_t<T>>(std::numeric_limits<T>::max()))
+        return false;
+      *static_cast<T*>(obj) = static_cast<T>(val);
+      return true;
+    } else if constexpr (std::is_floating_point<T>::value) {
+      *static_cast<T*>(obj) = static_cast<T>(val);
+      return true;
+    }
+    return false;
+  }
+
+  static bool set_double(void* obj, double val) {
+    if constexpr (std::is_floating_point<T>::value) {
+      *static_cast<T*>(obj) = static_cast<T>(val);
+      return true;
+    }
+    return false;
+  }
+
+  static bool set_string(void* obj, const std::string& val) {
+    if constexpr (std::is_same<T, std::string>::value) {
+      *static_cast<T*>(obj) = val;
+      return true;
+    }
+    return false;
+  }
+
+  static void clear(void* obj) {
+    if constexpr (is_vector<T>::value)
+      static_cast<T*>(obj)->clear();
+  }
+
+  static void* append(void* obj, const type_ops** ops) {
+    if constexpr (is_vector<T>::value) {
+      auto& vec = *static_cast<T*>(obj);
+      vec.emplace_back();
+      *ops = get_type_ops<typename T::value_type>();
+      return &vec.back();
+    }
+    return nullptr;
+  }
+
+  static void* find_field(void* obj, const std::string& key, const type_ops** ops) {
+    if constexpr (reflect<T>::defined) {
+      constexpr size_t size = std::tuple_size<decltype(reflect<T>::fields())>::value;
+      return find_field_aux(obj, key, ops, std::make_index_sequence<size>());
+    }
+    return nullptr;
+  }
+
+  // 字段名在编译期构建为 key_matcher，key 只需一次 hash 和一次比较即可确定字段，
+  // 再通过下标直接调用该字段的 bind_field_aux()
+  template <size_t... I>
+  static void* find_field_aux(void* obj, const std::string& key, const type_ops** ops,
+                              std::index_sequence<I...>) {
+    static constexpr auto matcher = make_key_matcher(
+        std::string_view(std::get<I>(reflect<T>::fields()).name_,
+                         std::get<I>(reflect<T>::fields()).length_)...);
+    using bind_type = void* (*)(void* obj, const type_ops** ops);
+    static constexpr bind_type binds[] = {&bind_field_aux<I>...};
+    size_t index = matcher.find(key);
+    if(index == matcher.size())
+      return nullptr;
+    return binds[index](obj, ops);
+  }
+
+  template <size_t I>
+  static void* bind_field_aux(void* obj, const type_ops** ops) {
+    auto& member = static_cast<T*>(obj)->*(std::get<I>(reflect<T>::fields()).member_);
+    *ops = get_type_ops<std::remove_reference_t<decltype(member)>>();
+    return &member;
+  }
+};
+
+template <typename T>
+const type_ops* get_type_ops() {
+  static const type_ops ops = {
+    reflect<T>::defined ? type_ops::OBJECT :
+      (is_vector<T>::value ? type_ops::ARRAY : type_ops::SCALAR),
+    &type_ops_impl<T>::set_bool,
+    &type_ops_impl<T>::set_int64,
+    &type_ops_impl<T>::set_uint64,
+    &type_ops_impl<T>::set_double,
+    &type_ops_impl<T>::set_string,
+    &type_ops_impl<T>::clear,
+    &type_ops_impl<T>::append,
+    &type_ops_impl<T>::find_field,
+  };
+  return &ops;
+}
+
+/**
+ * @description: struct_handler 是一个 handler，它将 reader 发出的事件直接写入 T 类型的对象中
+ */
+template <typename T>
+class struct_handler {
+public:
+  struct_handler(const struct_handler&) = delete;
+  struct_handler& operator=(const struct_handler&) = delete;
+
+  explicit struct_handler(T& target) :
+    slot_{&target, get_type_ops<T>()},
+    skip_(false),
+    mismatch_(false) {}
+
+  // 返回 true 表示解析失败是因为类型不符
+  bool mismatch() const {
+    return mismatch_;
+  }
+
+  bool skip_next_value() {
+    assert(!stack_.empty());
+    auto& top = stack_.back();
+    if(top.ops_->kind_ == type_ops::ARRAY) {
+      slot_.obj_ = top.ops_->append_(top.obj_, &slot_.ops_);
+      return false;
+    }
+    bool skip = skip_;
+    skip_ = false;
+    return skip;
+  }
+
+  bool handle_null() {
+    return true;
+  }
+
+  bool handle_bool(bool val) {
+    return check_aux(slot_.ops_->set_bool_(slot_.obj_, val));
+  }
+
+  bool handle_int32(int32_t val) {
+    return check_aux(slot_.ops_->set_int64_(slot_.obj_, val));
+  }
+
+  bool handle_int64(int64_t val) {
+    return check_aux(slot_.ops_->set_int64_(slot_.obj_, val));
+  }
+
+  bool handle_uint64(uint64_t val) {
+    return check_aux(slot_.ops_->set_uint64_(slot_.obj_, val));
+  }
+
+  bool handle_double(double val) {
+    return check_aux(slot_.ops_->set_double_(slot_.obj_, val));
+  }
+
+  bool handle_string(const std::string& str) {
+    return check_aux(slot_.ops_->set_string_(slot_.obj_, str));
+  }
+
+  bool handle_start_object() {
+    if(!check_aux(slot_.ops_->kind_ == type_ops::OBJECT))
+      return false;
+    stack_.push_back(slot_);
+    return true;
+  }
+
+  bool handle_key(const std::string& key) {
+    auto& top = stack_.back();
+    slot_.obj_ = top.ops_->find_field_(top.obj_, key, &slot_.ops_);
+    skip_ = slot_.obj_ == nullptr;
+    return true;
+  }
+
+  bool handle_end_object() {
+    stack_.pop_back();
+    return true;
+  }
+
+  bool handle_start_array() {
+    if(!check_aux(slot_.ops_->kind_ == type_ops::ARRAY))
+      return false;
+    slot_.ops_->clear_(slot_.obj_);
+    stack_.push_back(slot_);
+    return true;
+  }
+
+  bool handle_end_array() {
+    stack_.pop_back();
+    return true;
+  }
+
+private:
+  bool check_aux(bool ok) {
+    if(!ok)
+      mismatch_ = true;
+    return ok;
+  }
+
+  // slot 表示下一个 value 要写入的位置
+  struct slot {
+    void* obj_;
+    const type_ops* ops_;
+  };
+
+private:
+  slot slot_;
+  std::vector<slot> stack_;
+  bool skip_;
+  bool mismatch_;
+};
+
+template <unsigned flags = PARSE_FLAG_DEFAULT, typename ReadStream, typename T>
+parse_error parse_struct(ReadStream& stream, T& target) {
+  static_assert(reflect<T>::defined, "T must be described by JSON2_REFLECT");
+  struct_handler<T> handler(target);
+  parse_error err = reader::parse<flags>(stream, handler);
+  if(err == PARSE_USER_STOPPED && handler.mismatch())
+    return PARSE_TYPE_MISMATCH;
+  return err;
+}
+
+template <typename Handler, typename T>
+bool write_struct(Handler& handler, const T& val) {
+  if constexpr (std::is_same<T, bool>::value) {
+    return handler.handle_bool(val);
+  } else if constexpr (std::is_integral<T>::value) {
+    if constexpr (sizeof(T) < sizeof(int32_t) ||
+                  (sizeof(T) == sizeof(int32_t) && std::is_signed<T>::value)) {
+      return handler.handle_int32(static_cast<int32_t>(val));
+    } else if constexpr (std::is_unsigned<T>::value && sizeof(T) == sizeof(uint64_t)) {
+      // 超出 int64_t 范围的值与 reader 一样发送 handle_uint64()
+      if(val > static_cast<uint64_t>(std::numeric_limits<int64_t>::max()))
+        return dispatch_uint64(handler, static_cast<uint64_t>(val));
+      return handler.handle_int64(static_cast<int64_t>(val));
+    } else {
+      return handler.handle_int64(static_cast<int64_t>(val));
+    }
+  } else if constexpr (std::is_floating_point<T>::value) {
+    return handler.handle_double(static_cast<double>(val));
+  } else if constexpr (std::is_same<T, std::string>::value) {
+    return handler.handle_string(val);
+  } else if constexpr (is_vector<T>::value) {
+    using element_type = typename T::value_type;
+    // 数字数组整体输出（见 writer::handle_int64_array()）
+    if constexpr (has_packed_array_handler<Handler>::value &&
+                  std::is_same<element_type, int64_t>::value) {
+      return handler.handle_int64_array(val.data(), val.size());
+    } else if constexpr (has_packed_array_handler<Handler>::value &&
+                         std::is_same<element_type, double>::value) {
+      return handler.handle_double_array(val.data(), val.size());
+    } else {
+      if(!handler.handle_start_array())
+        return false;
+      for(const auto& elem : val) {
+        if(!write_struct(handler, static_cast<const element_type&>(elem)))
+          return false;
+      }
+      return handler.handle_end_array();
+    }
+  } else {
+    static_assert(reflect<T>::defined, "T must be described by JSON2_REFLECT");
+    if(!handler.handle_start_object())
+      return false;
+    bool ok = std::apply([&](const auto&... fields) {
+      return ((handler.handle_key(std::string(fields.name_, fields.length_)) &&
+               write_struct(handler, val.*(fields.member_))) && ...);
+    }, reflect<T>::fields());
+    return ok && handler.handle_end_object();
+  }
+}
+
+}
+
+// 以下宏用于对 JSON2_REFLECT 的每个字段名展开 JSON2_REFLECT_FIELD，最多支持 32 个字段
+#define JSON2_REFLECT_FIELD(type, name) json2::make_field(#name, &type::name)
+
+#define JSON2_REFLECT_N(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, \
+                        _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30,  \
+                        _31, _32, N, ...) JSON2_REFLECT_##N
+#define JSON2_REFLECT_1(t, a) JSON2_REFLECT_FIELD(t, a)
+#define JSON2_REFLECT_2(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_1(t, __VA_ARGS__)
+#define JSON2_REFLECT_3(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_2(t, __VA_ARGS__)
+#define JSON2_REFLECT_4(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_3(t, __VA_ARGS__)
+#define JSON2_REFLECT_5(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_4(t, __VA_ARGS__)
+#define JSON2_REFLECT_6(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_5(t, __VA_ARGS__)
+#define JSON2_REFLECT_7(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_6(t, __VA_ARGS__)
+#define JSON2_REFLECT_8(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_7(t, __VA_ARGS__)
+#define JSON2_REFLECT_9(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_8(t, __VA_ARGS__)
+#define JSON2_REFLECT_10(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_9(t, __VA_ARGS__)
+#define JSON2_REFLECT_11(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_10(t, __VA_ARGS__)
+#define JSON2_REFLECT_12(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_11(t, __VA_ARGS__)
+#define JSON2_REFLECT_13(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_12(t, __VA_ARGS__)
+#define JSON2_REFLECT_14(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_13(t, __VA_ARGS__)
+#define JSON2_REFLECT_15(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_14(t, __VA_ARGS__)
+#define JSON2_REFLECT_16(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_15(t, __VA_ARGS__)
+#define JSON2_REFLECT_17(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_16(t, __VA_ARGS__)
+#define JSON2_REFLECT_18(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_17(t, __VA_ARGS__)
+#define JSON2_REFLECT_19(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_18(t, __VA_ARGS__)
+#define JSON2_REFLECT_20(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_19(t, __VA_ARGS__)
+#define JSON2_REFLECT_21(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_20(t, __VA_ARGS__)
+#define JSON2_REFLECT_22(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_21(t, __VA_ARGS__)
+#define JSON2_REFLECT_23(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_22(t, __VA_ARGS__)
+#define JSON2_REFLECT_24(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_23(t, __VA_ARGS__)
+#define JSON2_REFLECT_25(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_24(t, __VA_ARGS__)
+#define JSON2_REFLECT_26(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_25(t, __VA_ARGS__)
+#define JSON2_REFLECT_27(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_26(t, __VA_ARGS__)
+#define JSON2_REFLECT_28(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_27(t, __VA_ARGS__)
+#define JSON2_REFLECT_29(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_28(t, __VA_ARGS__)
+#define JSON2_REFLECT_30(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_29(t, __VA_ARGS__)
+#define JSON2_REFLECT_31(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_30(t, __VA_ARGS__)
+#define JSON2_REFLECT_32(t, a, ...) JSON2_REFLECT_FIELD(t, a), JSON2_REFLECT_31(t, __VA_ARGS__)
+
+#define JSON2_REFLECT(type, ...)                                                         \
+  namespace json2 {                                                                      \
+  template <>                                                                            \
+  struct reflect<type> {                                                                 \
+    static constexpr bool defined = true;                                                \
+    static constexpr auto fields() {                                                     \
+      return std::make_tuple(JSON2_REFLECT_N(__VA_ARGS__, 32, 31, 30, 29, 28, 27, 26, 25, \
+                             24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, \
+                             9, 8, 7, 6, 5, 4, 3, 2, 1)(type, __VA_ARGS__));             \
+    }                                                                                    \
+  };                                                                                     \
+  }
+
+#endif
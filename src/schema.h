@@ -0,0 +1,573 @@
+#ifndef _SCHEMA_H_
+#define _SCHEMA_H_
+
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "exception.h"
+#include "value.h"
+#include "reader.h"
+#include "document.h"
+#include "key_matcher.h"
+
+namespace json2 {
+
+class validator;
+
+/**
+ * @description: schema 是编译之后的 JSON Schema。编译只需一次，之后 validator 依据它在一次 SAX 解析中
+ *      完成校验，既不构建 DOM，也不保存任何 value：
+ *  ```
+ *    schema s;
+ *    parse_error err = s.parse(schema_stream);     // 或 s.compile(doc)，doc 为已经解析好的 schema
+ *
+ *    validator v(s);                               // 可以在多个请求之间复用，不再分配内存
+ *    err = v.validate(body_stream);
+ *    if(err == PARSE_SCHEMA_MISMATCH)
+ *      log(v.get_violation());                     // 不满足的关键字，如 "required"
+ *  ```
+ *  支持的关键字：
+ *    - type：string 或 string 的 array，取值为 null、boolean、integer、number、string、array、object，
+ *      integer 也包括小数部分为 0 的浮点数（如 1.0）
+ *    - enum：元素只能为 null、bool、数字或 string，数字按数值比较（1 与 1.0 相等）
+ *    - minimum、maximum、exclusiveMinimum、exclusiveMaximum（数字形式），数字按 double 比较
+ *    - minLength、maxLength，按 Unicode 字符（而不是字节）计数
+ *    - properties、required
+ *    - items（只支持单个 schema 的形式）、minItems、maxItems
+ *  schema 本身也可以为 true / false。title、description、default、format 等注解类的关键字以及未知的关键字
+ *  被忽略；$ref、anyOf、additionalProperties 等会影响校验结果却不被支持的关键字使编译返回 PARSE_BAD_SCHEMA，
+ *  而不是被静默地忽略。
+ *
+ *  编译的结果是一张紧凑的状态表：每个（子）schema 一个 node，properties 的 key 通过 dynamic_key_matcher
+ *  查找，不受任何约束的子 schema（如没有出现在 properties 中的 key）统一为 nodes_[0]，
+ *  validator 遇到它时通过 skip_next_value() 直接跳过整个 value。
+ */
+class schema {
+  friend class validator;
+
+public:
+  schema() {
+    reset_aux();
+  }
+
+  // 解析并编译 stream 中的 schema
+  template <unsigned flags = PARSE_FLAG_DEFAULT, typename ReadStream>
+  parse_error parse(ReadStream& stream) {
+    // enum 等 array 按普通的 array 构建即可
+    document doc(false);
+    parse_error err = doc.template parse<flags>(stream);
+    if(err != PARSE_OK)
+      return err;
+    return compile(doc);
+  }
+
+  parse_error compile(const value& root) {
+    reset_aux();
+    try {
+      root_ = compile_node_aux(root);
+    } catch(json_exception& e) {
+      reset_aux();
+      return e.error();
+    }
+    return PARSE_OK;
+  }
+
+private:
+  // 类型的集合，每个类型一位，顺序与 type_names_ 相同
+  enum type_mask : uint8_t {
+    MASK_NULL = 1 << 0,
+    MASK_BOOLEAN = 1 << 1,
+    MASK_INTEGER = 1 << 2,
+    MASK_NUMBER = 1 << 3,   // 包括 integer
+    MASK_STRING = 1 << 4,
+    MASK_ARRAY = 1 << 5,
+    MASK_OBJECT = 1 << 6,
+    MASK_ANY = (1 << 7) - 1,
+  };
+
+  static constexpr uint32_t npos = std::numeric_limits<uint32_t>::max();
+
+  struct node {
+    uint8_t types_ = MASK_ANY;
+    bool has_enum_ = false;
+    double minimum_ = -std::numeric_limits<double>::infinity();
+    double maximum_ = std::numeric_limits<double>::infinity();
+    double exclusive_minimum_ = -std::numeric_limits<double>::infinity();
+    double exclusive_maximum_ = std::numeric_limits<double>::infinity();
+    size_t min_length_ = 0;
+    size_t max_length_ = std::numeric_limits<size_t>::max();
+    size_t min_items_ = 0;
+    size_t max_items_ = std::numeric_limits<size_t>::max();
+    uint32_t items_ = 0;            // 元素的 schema，0 表示任意
+    uint32_t properties_ = npos;    // matchers_ 中的下标，npos 表示没有 properties 和 required
+    uint32_t property_begin_ = 0;   // 各个 property 的 schema 在 property_nodes_ 中的开始位置，顺序与 matcher 相同
+    uint32_t required_ = 0;         // 前 required_ 个 property 为 required
+    uint32_t enum_begin_ = 0;       // enums_ 中的 [enum_begin_, enum_end_)
+    uint32_t enum_end_ = 0;
+  };
+
+  // enum 中的一个值：null 和 bool 也用 number_ 表示（0 / 1），以便统一比较
+  struct enum_value {
+    uint8_t type_;
+    double number_;
+    std::string string_;
+  };
+
+  enum keyword_index {
+    KEYWORD_TYPE,
+    KEYWORD_ENUM,
+    KEYWORD_MINIMUM,
+    KEYWORD_MAXIMUM,
+    KEYWORD_EXCLUSIVE_MINIMUM,
+    KEYWORD_EXCLUSIVE_MAXIMUM,
+    KEYWORD_MIN_LENGTH,
+    KEYWORD_MAX_LENGTH,
+    KEYWORD_MIN_ITEMS,
+    KEYWORD_MAX_ITEMS,
+    KEYWORD_PROPERTIES,
+    KEYWORD_REQUIRED,
+    KEYWORD_ITEMS,
+    KEYWORD_UNSUPPORTED,    // 之后的都是不支持的关键字
+  };
+
+  static constexpr auto keywords_ = make_key_matcher(
+      "type", "enum", "minimum", "maximum", "exclusiveMinimum", "exclusiveMaximum",
+      "minLength", "maxLength", "minItems", "maxItems", "properties", "required", "items",
+      "$ref", "allOf", "anyOf", "oneOf", "not", "if", "const", "multipleOf", "pattern",
+      "additionalProperties", "patternProperties", "propertyNames", "minProperties", "maxProperties",
+      "dependencies", "dependentRequired", "dependentSchemas", "additionalItems", "prefixItems",
+      "contains", "uniqueItems", "unevaluatedProperties", "unevaluatedItems");
+
+  static constexpr auto type_names_ = make_key_matcher(
+      "null", "boolean", "integer", "number", "string", "array", "object");
+
+  void reset_aux() {
+    nodes_.assign(1, node());
+    property_nodes_.clear();
+    matchers_.clear();
+    enums_.clear();
+    root_ = 0;
+  }
+
+  // 编译一个（子）schema，返回其 node 的下标
+  uint32_t compile_node_aux(const value& val) {
+    if(val.is_bool()) {
+      if(val.get_bool_value())
+        return 0;
+      node n;
+      n.types_ = 0;
+      return add_node_aux(n);
+    }
+    if(!val.is_object())
+      throw json_exception(PARSE_BAD_SCHEMA);
+
+    node n;
+    bool any = true;
+    const value* properties = nullptr;
+    const value* required = nullptr;
+    for(const auto& elem : val.get_object_value()) {
+      const value& arg = elem.value_;
+      size_t keyword = keywords_.find(elem.key_.get_string_value());
+      if(keyword == keywords_.size())
+        continue;
+      if(keyword >= KEYWORD_UNSUPPORTED)
+        throw json_exception(PARSE_BAD_SCHEMA);
+      any = false;
+      switch(keyword) {
+        case KEYWORD_TYPE:
+          n.types_ = compile_types_aux(arg);
+          break;
+        case KEYWORD_ENUM:
+          compile_enum_aux(arg, n);
+          break;
+        case KEYWORD_MINIMUM:
+          n.minimum_ = get_number_aux(arg);
+          break;
+        case KEYWORD_MAXIMUM:
+          n.maximum_ = get_number_aux(arg);
+          break;
+        case KEYWORD_EXCLUSIVE_MINIMUM:
+          n.exclusive_minimum_ = get_number_aux(arg);
+          break;
+        case KEYWORD_EXCLUSIVE_MAXIMUM:
+          n.exclusive_maximum_ = get_number_aux(arg);
+          break;
+        case KEYWORD_MIN_LENGTH:
+          n.min_length_ = get_count_aux(arg);
+          break;
+        case KEYWORD_MAX_LENGTH:
+          n.max_length_ = get_count_aux(arg);
+          break;
+        case KEYWORD_MIN_ITEMS:
+          n.min_items_ = get_count_aux(arg);
+          break;
+        case KEYWORD_MAX_ITEMS:
+          n.max_items_ = get_count_aux(arg);
+          break;
+        case KEYWORD_PROPERTIES:
+          properties = &arg;
+          break;
+        case KEYWORD_REQUIRED:
+          required = &arg;
+          break;
+        case KEYWORD_ITEMS:
+          // 子 schema 先于当前 node 加入 nodes_
+          n.items_ = compile_node_aux(arg);
+          break;
+      }
+    }
+    if(any)
+      return 0;
+    if(properties != nullptr || required != nullptr)
+      compile_properties_aux(properties, required, n);
+    return add_node_aux(n);
+  }
+
+  uint32_t add_node_aux(const node& n) {
+    nodes_.push_back(n);
+    return static_cast<uint32_t>(nodes_.size() - 1);
+  }
+
+  uint8_t compile_types_aux(const value& arg) {
+    if(arg.is_string())
+      return get_type_mask_aux(arg);
+    if(!arg.is_array() || arg.is_packed_array())
+      throw json_exception(PARSE_BAD_SCHEMA);
+    uint8_t types = 0;
+    for(const auto& elem : arg.get_array_value())
+      types |= get_type_mask_aux(elem);
+    return types;
+  }
+
+  uint8_t get_type_mask_aux(const value& name) {
+    if(!name.is_string())
+      throw json_exception(PARSE_BAD_SCHEMA);
+    size_t index = type_names_.find(name.get_string_value());
+    if(index == type_names_.size())
+      throw json_exception(PARSE_BAD_SCHEMA);
+    return static_cast<uint8_t>(1 << index);
+  }
+
+  void compile_enum_aux(const value& arg, node& n) {
+    n.has_enum_ = true;
+    n.enum_begin_ = static_cast<uint32_t>(enums_.size());
+    if(arg.get_type() == TYPE_INT64_ARRAY) {
+      for(int64_t elem : arg.get_int64_array_value())
+        enums_.push_back({MASK_NUMBER, static_cast<double>(elem), std::string()});
+    } else if(arg.get_type() == TYPE_DOUBLE_ARRAY) {
+      for(double elem : arg.get_double_array_value())
+        enums_.push_back({MASK_NUMBER, elem, std::string()});
+    } else if(arg.get_type() == TYPE_ARRAY) {
+      for(const auto& elem : arg.get_array_value()) {
+        if(elem.is_null())
+          enums_.push_back({MASK_NULL, 0, std::string()});
+        else if(elem.is_bool())
+          enums_.push_back({MASK_BOOLEAN, elem.get_bool_value() ? 1.0 : 0.0, std::string()});
+        else if(elem.is_string())
+          enums_.push_back({MASK_STRING, 0, elem.get_string_value()});
+        else
+          enums_.push_back({MASK_NUMBER, get_number_aux(elem), std::string()});
+      }
+    } else {
+      throw json_exception(PARSE_BAD_SCHEMA);
+    }
+    n.enum_end_ = static_cast<uint32_t>(enums_.size());
+  }
+
+  // required 中的 key 排在前面，properties 中其余的 key 排在后面，required 而没有出现在 properties 中的 key
+  // 的 schema 为任意
+  void compile_properties_aux(const value* properties, const value* required, node& n) {
+    std::vector<std::string> keys;
+    std::vector<uint32_t> children;
+    if(required != nullptr) {
+      if(required->get_type() != TYPE_ARRAY)
+        throw json_exception(PARSE_BAD_SCHEMA);
+      for(const auto& elem : required->get_array_value()) {
+        if(!elem.is_string())
+          throw json_exception(PARSE_BAD_SCHEMA);
+        std::string key = elem.get_string_value();
+        if(find_key_aux(keys, key) == keys.size()) {
+          keys.push_back(std::move(key));
+          children.push_back(0);
+        }
+      }
+    }
+    n.required_ = static_cast<uint32_t>(keys.size());
+    if(properties != nullptr) {
+      if(!properties->is_object())
+        throw json_exception(PARSE_BAD_SCHEMA);
+      for(const auto& elem : properties->get_object_value()) {
+        std::string key = elem.key_.get_string_value();
+        uint32_t child = compile_node_aux(elem.value_);
+        size_t index = find_key_aux(keys, key);
+        if(index == keys.size()) {
+          keys.push_back(std::move(key));
+          children.push_back(child);
+        } else {
+          children[index] = child;
+        }
+      }
+    }
+    n.properties_ = static_cast<uint32_t>(matchers_.size());
+    n.property_begin_ = static_cast<uint32_t>(property_nodes_.size());
+    matchers_.emplace_back(std::move(keys));
+    property_nodes_.insert(property_nodes_.end(), children.begin(), children.end());
+  }
+
+  static size_t find_key_aux(const std::vector<std::string>& keys, const std::string& key) {
+    for(size_t i = 0; i < keys.size(); i++) {
+      if(keys[i] == key)
+        return i;
+    }
+    return keys.size();
+  }
+
+  static double get_number_aux(const value& arg) {
+    switch(arg.get_type()) {
+      case TYPE_INT32:
+      case TYPE_INT64:
+        return static_cast<double>(arg.get_int64_value());
+      case TYPE_DOUBLE:
+      case TYPE_NUMBER:
+        return arg.get_double_value();
+      default:
+        throw json_exception(PARSE_BAD_SCHEMA);
+    }
+  }
+
+  // 非负整数（可以写作 2.0）
+  static size_t get_count_aux(const value& arg) {
+    double count = get_number_aux(arg);
+    if(count < 0 || std::floor(count) != count)
+      throw json_exception(PARSE_BAD_SCHEMA);
+    if(count >= static_cast<double>(std::numeric_limits<size_t>::max()))
+      return std::numeric_limits<size_t>::max();
+    return static_cast<size_t>(count);
+  }
+
+private:
+  std::vector<node> nodes_;               // nodes_[0] 不受任何约束
+  std::vector<uint32_t> property_nodes_;
+  std::vector<dynamic_key_matcher> matchers_;
+  std::vector<enum_value> enums_;
+  uint32_t root_;
+};
+
+/**
+ * @description: validator 是一个 handler，它依据 schema 校验 reader 发出的事件。
+ *      第一处不符合 schema 的 value 即返回 false，reader 随即停止解析（PARSE_USER_STOPPED），
+ *      validate() 将其转换为 PARSE_SCHEMA_MISMATCH，get_violation() 返回所违反的关键字。
+ *  - 除了每层 object 的 required 记录（每个 required 的 key 一位）之外不保存任何内容
+ *  - schema 没有约束的 value（没有出现在 properties 中的 key、没有 items 的 array 的元素等）通过
+ *    skip_next_value() 直接跳过，既不解码也不转换，因此其中只做最基本的结构检查（见 reader.h）
+ *  - schema 必须在 validator 使用期间一直有效
+ */
+class validator {
+public:
+  validator(const validator&) = delete;
+  validator& operator=(const validator&) = delete;
+
+  explicit validator(const schema& s) :
+    schema_(s),
+    pending_(s.root_),
+    violation_(nullptr) {}
+
+  template <unsigned flags = PARSE_FLAG_DEFAULT, typename ReadStream>
+  parse_error validate(ReadStream& stream) {
+    static_assert((flags & (PARSE_FLAG_RAW | PARSE_FLAG_RAW_NUMBER)) == 0,
+                  "validator needs decoded strings and numbers");
+    frames_.clear();
+    required_bits_.clear();
+    pending_ = schema_.root_;
+    violation_ = nullptr;
+    parse_error err = reader::parse<flags>(stream, *this, context_);
+    if(err == PARSE_USER_STOPPED && violation_ != nullptr)
+      return PARSE_SCHEMA_MISMATCH;
+    return err;
+  }
+
+  // 最近一次 validate() 所违反的关键字（如 "type"、"required"），符合 schema 时返回 nullptr
+  const char* get_violation() const {
+    return violation_;
+  }
+
+  // 见 reader_context::max_depth_
+  void set_max_depth(size_t max_depth) {
+    context_.max_depth_ = max_depth;
+  }
+
+public:
+  bool skip_next_value() {
+    assert(!frames_.empty());
+    auto& top = frames_.back();
+    if(top.in_array_) {
+      top.count_++;
+      pending_ = schema_.nodes_[top.node_].items_;
+    }
+    // object 中的 pending_ 已由 handle_key() 设置
+    return pending_ == 0;
+  }
+
+  bool handle_null() {
+    const auto& n = schema_.nodes_[pending_];
+    return check_type_aux(n, schema::MASK_NULL) && check_enum_aux(n, schema::MASK_NULL, 0, std::string_view());
+  }
+
+  bool handle_bool(bool val) {
+    const auto& n = schema_.nodes_[pending_];
+    return check_type_aux(n, schema::MASK_BOOLEAN) &&
+           check_enum_aux(n, schema::MASK_BOOLEAN, val ? 1.0 : 0.0, std::string_view());
+  }
+
+  bool handle_int32(int32_t val) {
+    return check_number_aux(val, true);
+  }
+
+  bool handle_int64(int64_t val) {
+    return check_number_aux(static_cast<double>(val), true);
+  }
+
+  bool handle_uint64(uint64_t val) {
+    return check_number_aux(static_cast<double>(val), true);
+  }
+
+  bool handle_double(double val) {
+    return check_number_aux(val, std::floor(val) == val);
+  }
+
+  bool handle_string(const std::string& str) {
+    const auto& n = schema_.nodes_[pending_];
+    if(!check_type_aux(n, schema::MASK_STRING))
+      return false;
+    if(n.min_length_ != 0 || n.max_length_ != std::numeric_limits<size_t>::max()) {
+      // 不计 UTF-8 的后续字节（10xxxxxx），即按 Unicode 字符计数
+      size_t length = 0;
+      for(char ch : str)
+        length += (static_cast<unsigned char>(ch) & 0xC0) != 0x80;
+      if(length < n.min_length_)
+        return fail_aux("minLength");
+      if(length > n.max_length_)
+        return fail_aux("maxLength");
+    }
+    return check_enum_aux(n, schema::MASK_STRING, 0, str);
+  }
+
+  bool handle_key(const std::string& key) {
+    auto& top = frames_.back();
+    const auto& n = schema_.nodes_[top.node_];
+    pending_ = 0;
+    if(n.properties_ == schema::npos)
+      return true;
+    const auto& matcher = schema_.matchers_[n.properties_];
+    size_t index = matcher.find(key);
+    if(index == matcher.size())
+      return true;
+    pending_ = schema_.property_nodes_[n.property_begin_ + index];
+    if(index < n.required_) {
+      uint64_t& bits = required_bits_[top.bits_ + index / 64];
+      uint64_t bit = uint64_t(1) << (index % 64);
+      // 重复的 key 只计一次
+      if((bits & bit) == 0) {
+        bits |= bit;
+        top.count_++;
+      }
+    }
+    return true;
+  }
+
+  bool handle_start_object() {
+    const auto& n = schema_.nodes_[pending_];
+    if(!check_type_aux(n, schema::MASK_OBJECT))
+      return false;
+    frames_.push_back({pending_, false, 0, required_bits_.size()});
+    required_bits_.resize(required_bits_.size() + (n.required_ + 63) / 64, 0);
+    return true;
+  }
+
+  bool handle_end_object() {
+    const auto& top = frames_.back();
+    bool ok = top.count_ == schema_.nodes_[top.node_].required_;
+    required_bits_.resize(top.bits_);
+    frames_.pop_back();
+    return ok || fail_aux("required");
+  }
+
+  bool handle_start_array() {
+    if(!check_type_aux(schema_.nodes_[pending_], schema::MASK_ARRAY))
+      return false;
+    frames_.push_back({pending_, true, 0, required_bits_.size()});
+    return true;
+  }
+
+  bool handle_end_array() {
+    const auto& top = frames_.back();
+    const auto& n = schema_.nodes_[top.node_];
+    size_t count = top.count_;
+    frames_.pop_back();
+    if(count < n.min_items_)
+      return fail_aux("minItems");
+    if(count > n.max_items_)
+      return fail_aux("maxItems");
+    return true;
+  }
+
+private:
+  bool fail_aux(const char* keyword) {
+    violation_ = keyword;
+    return false;
+  }
+
+  bool check_type_aux(const schema::node& n, uint8_t mask) {
+    return (n.types_ & mask) != 0 || fail_aux("type");
+  }
+
+  bool check_number_aux(double val, bool integral) {
+    const auto& n = schema_.nodes_[pending_];
+    if(!check_type_aux(n, integral ? schema::MASK_INTEGER | schema::MASK_NUMBER : schema::MASK_NUMBER))
+      return false;
+    if(val < n.minimum_)
+      return fail_aux("minimum");
+    if(val > n.maximum_)
+      return fail_aux("maximum");
+    if(val <= n.exclusive_minimum_)
+      return fail_aux("exclusiveMinimum");
+    if(val >= n.exclusive_maximum_)
+      return fail_aux("exclusiveMaximum");
+    return check_enum_aux(n, schema::MASK_NUMBER, val, std::string_view());
+  }
+
+  bool check_enum_aux(const schema::node& n, uint8_t type, double number, std::string_view str) {
+    if(!n.has_enum_)
+      return true;
+    for(uint32_t i = n.enum_begin_; i < n.enum_end_; i++) {
+      const auto& e = schema_.enums_[i];
+      if(e.type_ == type && e.number_ == number && e.string_ == str)
+        return true;
+    }
+    return fail_aux("enum");
+  }
+
+  // frame 表示当前所在的 array 或 object
+  struct frame {
+    uint32_t node_;
+    bool in_array_;
+    size_t count_;    // array 中已有的元素个数，或 object 中已出现的 required 的 key 的个数
+    size_t bits_;     // 该 object 的 required 记录在 required_bits_ 中的开始位置
+  };
+
+private:
+  const schema& schema_;
+  std::vector<frame> frames_;
+  std::vector<uint64_t> required_bits_;
+  uint32_t pending_;          // 下一个 value 的 schema
+  const char* violation_;
+  reader_context context_;
+};
+
+}
+
+#endif
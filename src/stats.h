@@ -0,0 +1,99 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace json2 {
+
+/**
+ * @description: 统计信息（instrumentation），用于了解实际的输入落在哪些路径上，例如数字和 string 的比例、
+ *      有多少 string 需要处理转义字符、解析数字和解析 string 各自花费的时间等。
+ *
+ *  只有在编译时定义了 JSON2_ENABLE_STATS 时才会统计，否则所有统计代码（JSON2_STATS(...)）
+ *  都会被预处理器去掉，reader / writer 的代码与不统计时完全相同：
+ *  ```
+ *    g++ -DJSON2_ENABLE_STATS ...
+ *
+ *    parser p;
+ *    p.parse(in, handler);
+ *    const stats& s = p.get_stats();     // 或者 document::get_stats()、writer::get_stats()
+ *  ```
+ *  统计结果在多次解析之间累加，需要时调用 reset() 清零。
+ *
+ *  内存分配只统计 reader_context 中 buffer 的扩容（reader_buffer_growths_），这是有意的取舍：
+ *  document / value 的结点、string 以及 handler 自身的内存分配不经过 reader，要统计它们只能替换全局的
+ *  operator new，这超出了 stats 的范围。需要完整的分配次数时，可以像 example/bench.cpp 那样替换 operator new。
+ */
+struct stats {
+public:
+  void reset() {
+    *this = stats();
+  }
+
+public:
+  // 各类事件的次数
+  size_t null_count_ = 0;
+  size_t bool_count_ = 0;
+  size_t int32_count_ = 0;
+  size_t int64_count_ = 0;
+  size_t uint64_count_ = 0;
+  size_t double_count_ = 0;
+  size_t raw_number_count_ = 0;     // PARSE_FLAG_RAW / PARSE_FLAG_RAW_NUMBER 模式下的数字
+  size_t string_count_ = 0;
+  size_t key_count_ = 0;
+  size_t object_count_ = 0;
+  size_t array_count_ = 0;
+
+  // 以下只由 reader 统计
+  size_t escaped_string_count_ = 0; // 含有转义字符的 string / key
+  size_t plain_string_count_ = 0;   // 不含转义字符的 string / key
+  size_t bytes_ = 0;                // 解析的字节数
+  // reader_context 中 buffer 扩容（即分配内存）的次数；document / value 以及 handler 自身的内存分配不在其中
+  size_t reader_buffer_growths_ = 0;
+  uint64_t number_nanos_ = 0;       // 解析数字所花费的时间，不含 handler 处理该数字的时间
+  uint64_t string_nanos_ = 0;       // 解析 string / key 所花费的时间，不含 handler 处理的时间
+
+  size_t max_depth_ = 0;            // array / object 嵌套的最大层数
+};
+
+// stats_timer 将从构造到 stop()（或析构）之间的时间累加到 nanos 上
+class stats_timer {
+public:
+  stats_timer(const stats_timer&) = delete;
+  stats_timer& operator=(const stats_timer&) = delete;
+
+  explicit stats_timer(uint64_t& nanos) :
+    nanos_(nanos),
+    start_(std::chrono::steady_clock::now()),
+    stopped_(false) {}
+
+  ~stats_timer() {
+    stop();
+  }
+
+  // 提前结束计时，之后再调用 stop() 或析构都不再累加
+  void stop() {
+    if(stopped_)
+      return;
+    stopped_ = true;
+    nanos_ += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start_).count();
+  }
+
+private:
+  uint64_t& nanos_;
+  std::chrono::steady_clock::time_point start_;
+  bool stopped_;
+};
+
+}
+
+#ifdef JSON2_ENABLE_STATS
+#define JSON2_STATS(...) __VA_ARGS__
+#else
+#define JSON2_STATS(...)
+#endif
+
+#endif
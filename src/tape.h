@@ -0,0 +1,525 @@
+#ifndef _TAPE_H_
+#define _TAPE_H_
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "exception.h"
+#include "value.h"
+#include "reader.h"
+
+namespace json2 {
+
+// array / object 的元素个数超过 TAPE_MAX_COUNT 时，只记录 TAPE_MAX_COUNT，get_size() 时再逐个计数
+constexpr uint64_t TAPE_MAX_COUNT = (uint64_t(1) << 24) - 1;
+
+/**
+ * @description: tape 是一种只读的扁平存储结构：整个 json 存储在一个连续的 uint64_t 数组（tape_）
+ *      和一个连续的 string 区（strings_）中，而不是像 value 那样每个 array / object 各自分配内存。
+ *
+ *  每个 word 的高 8 位为 tag，低 56 位为 payload：
+ *    'n' / 't' / 'f'    null / true / false
+ *    'i'                int32，payload 的低 32 位即为数值
+ *    'l' / 'd'          int64 / double，数值存储在下一个 word 中
+ *    's' / 'k'          string / key，payload 为其在 strings_ 中的偏移量，
+ *                       strings_ 中依次存放 4 字节的长度、内容以及 '\0'
+ *    '[' / '{'          array / object 的开始，payload 的低 32 位为对应的 ']' / '}' 的下标，
+ *                       高 24 位为元素（成员）的个数
+ *    ']' / '}'          array / object 的结束，payload 为对应的 '[' / '{' 的下标
+ *  object 的每个成员依次存放 'k' 以及其 value。由于 array / object 记录了结束的位置，
+ *  跳到下一个兄弟结点只需 O(1) 的时间，不需要遍历整个子树。
+ *
+ *  tape 中只有下标和偏移量，没有指针，因此 tape_cursor 只需要 tape 和 string 区的起始地址，
+ *  既可以读取 tape_document 中的数据，也可以直接读取 mmap 的文件（见 mapped_tape）。
+ */
+class tape_cursor {
+public:
+  tape_cursor() :
+    tape_(nullptr),
+    strings_(nullptr),
+    idx_(0) {}
+
+  tape_cursor(const uint64_t* tape, const char* strings, size_t idx) :
+    tape_(tape),
+    strings_(strings),
+    idx_(idx) {}
+
+  // 不存在的元素（如 find_element() 找不到 key，或 next() 越过了最后一个元素）返回的 cursor 无效
+  bool is_valid() const {
+    return tape_ != nullptr;
+  }
+
+  inline value_type get_type() const;
+  inline size_t get_size() const;
+
+  bool is_null() const {
+    return tag_aux() == 'n';
+  }
+
+  bool is_bool() const {
+    return tag_aux() == 't' || tag_aux() == 'f';
+  }
+
+  bool is_int32() const {
+    return tag_aux() == 'i';
+  }
+
+  bool is_int64() const {
+    return tag_aux() == 'l';
+  }
+
+  bool is_double() const {
+    return tag_aux() == 'd';
+  }
+
+  bool is_string() const {
+    return tag_aux() == 's';
+  }
+
+  bool is_array() const {
+    return tag_aux() == '[';
+  }
+
+  bool is_object() const {
+    return tag_aux() == '{';
+  }
+
+  // 当前 cursor 指向 object 的某个成员时（见 first()），is_key() 为 true
+  bool is_key() const {
+    return tag_aux() == 'k';
+  }
+
+  bool get_bool_value() const {
+    assert(is_bool());
+    return tag_aux() == 't';
+  }
+
+  int32_t get_int32_value() const {
+    assert(is_int32());
+    return static_cast<int32_t>(static_cast<uint32_t>(payload_aux()));
+  }
+
+  // 对于 int32_t 类型的值也可以在此处返回
+  inline int64_t get_int64_value() const;
+  inline double get_double_value() const;
+
+  // 返回的 string_view 指向 tape_document 内部的 string 区，其有效期与 tape_document 相同
+  inline std::string_view get_string_value() const;
+
+  std::string_view get_key() const {
+    assert(is_key());
+    return get_string_aux();
+  }
+
+  // 当前 cursor 指向 object 的某个成员时，返回该成员的 value
+  tape_cursor get_value() const {
+    assert(is_key());
+    return tape_cursor(tape_, strings_, idx_ + 1);
+  }
+
+  // 返回 array 的第一个元素或 object 的第一个成员，为空时返回无效的 cursor
+  inline tape_cursor first() const;
+  // 返回下一个兄弟结点（array 的下一个元素或 object 的下一个成员），O(1)；root 返回无效的 cursor
+  inline tape_cursor next() const;
+
+  inline tape_cursor find_element(std::string_view key) const;
+
+  tape_cursor operator[] (std::string_view key) const {
+    tape_cursor iter = find_element(key);
+    assert(iter.is_valid() && "key not found");
+    return iter.get_value();
+  }
+
+  tape_cursor operator[] (size_t idx) const {
+    assert(is_array());
+    tape_cursor iter = first();
+    while(idx-- > 0) {
+      assert(iter.is_valid() && "index out of range");
+      iter = iter.next();
+    }
+    assert(iter.is_valid() && "index out of range");
+    return iter;
+  }
+
+  // 按顺序向 handler 重新发送当前 value 对应的事件（见 value::write_to()）
+  template <typename Handler>
+  bool write_to(Handler& handler) const;
+
+private:
+  uint64_t word_aux(size_t idx) const {
+    assert(tape_ != nullptr);
+    return tape_[idx];
+  }
+
+  char tag_aux() const {
+    return static_cast<char>(word_aux(idx_) >> 56);
+  }
+
+  uint64_t payload_aux() const {
+    return word_aux(idx_) & ((uint64_t(1) << 56) - 1);
+  }
+
+  // 跳过 idx 处的 value，返回其之后的下标
+  size_t skip_aux(size_t idx) const {
+    switch(static_cast<char>(word_aux(idx) >> 56)) {
+      case '[':
+      case '{':
+        return (word_aux(idx) & 0xffffffff) + 1;
+      case 'l':
+      case 'd':
+        return idx + 2;
+      case 'k':
+        return skip_aux(idx + 1);
+      default:
+        return idx + 1;
+    }
+  }
+
+  std::string_view get_string_aux() const {
+    const char* str = strings_ + payload_aux();
+    uint32_t length;
+    memcpy(&length, str, sizeof(length));
+    return std::string_view(str + sizeof(length), length);
+  }
+
+private:
+  const uint64_t* tape_;
+  const char* strings_;
+  size_t idx_;
+};
+
+/**
+ * @description: tape 文件的头部，共 32 字节，之后依次为 tape（tape_size_ 个 uint64_t）和 string 区。
+ *      头部的大小是 8 的倍数，因此 mmap 之后 tape 仍然是对齐的。
+ *      文件使用本机字节序，byte_order_ 用于检查文件是否由相同字节序的机器生成
+ */
+struct tape_file_header {
+public:
+  char magic_[8] = {'J', 'S', 'O', 'N', '2', 'T', 'A', 'P'};
+  uint32_t version_ = 1;
+  uint32_t byte_order_ = 0x01020304;
+  uint64_t tape_size_ = 0;
+  uint64_t strings_size_ = 0;
+};
+
+static_assert(sizeof(tape_file_header) == 32, "tape_file_header must be 32 bytes");
+
+/**
+ * @description: tape_document 是一个 handler，接收 reader 的事件直接构建 tape（见 tape_cursor），
+ *      也可以通过 freeze() 将已有的 value 转换为 tape。构建完成后只能读取，不能修改。
+ *  ```
+ *    tape_document tape;
+ *    tape.parse(in);          // 或者 tape.freeze(doc);
+ *    tape_cursor root = tape.root();
+ *    int64_t port = root["server"]["port"].get_int64_value();
+ *  ```
+ *  适用于读多写少的场景（如配置）：所有数据只占用两块连续的内存，遍历时的 cache 命中率很高。
+ */
+class tape_document {
+public:
+  tape_document(const tape_document&) = delete;
+  tape_document& operator=(const tape_document&) = delete;
+
+  tape_document() = default;
+
+  template <unsigned flags = PARSE_FLAG_DEFAULT, typename ReadStream>
+  parse_error parse(ReadStream& stream) {
+    reset_aux();
+    parse_error err = reader::parse<flags>(stream, *this, context_);
+    if(err != PARSE_OK)
+      reset_aux();
+    return err;
+  }
+
+  // 将 val 转换为 tape，val 本身不受影响
+  void freeze(const value& val) {
+    reset_aux();
+    val.write_to(*this);
+  }
+
+  tape_cursor root() const {
+    assert(!tape_.empty());
+    return tape_cursor(tape_.data(), strings_.data(), 0);
+  }
+
+  // tape_ 和 strings_ 所占用的字节数
+  size_t get_memory_size() const {
+    return tape_.size() * sizeof(uint64_t) + strings_.size();
+  }
+
+  // 将 tape 以 tape_file_header、tape_、strings_ 的顺序输出至 stream，得到的文件可以
+  // 直接 mmap 使用（见 mapped_tape）
+  template <typename WriteStream>
+  void save(WriteStream& stream) const {
+    assert(!tape_.empty());
+    tape_file_header header;
+    header.tape_size_ = tape_.size();
+    header.strings_size_ = strings_.size();
+    stream.dump(reinterpret_cast<const char*>(&header), sizeof(header));
+    stream.dump(reinterpret_cast<const char*>(tape_.data()), tape_.size() * sizeof(uint64_t));
+    stream.dump(strings_.data(), strings_.size());
+  }
+
+public:
+  bool handle_null() {
+    add_word_aux('n', 0);
+    return true;
+  }
+
+  bool handle_bool(bool val) {
+    add_word_aux(val ? 't' : 'f', 0);
+    return true;
+  }
+
+  bool handle_int32(int32_t val) {
+    add_word_aux('i', static_cast<uint32_t>(val));
+    return true;
+  }
+
+  bool handle_int64(int64_t val) {
+    add_word_aux('l', 0);
+    tape_.push_back(static_cast<uint64_t>(val));
+    return true;
+  }
+
+  bool handle_double(double val) {
+    uint64_t bits;
+    memcpy(&bits, &val, sizeof(bits));
+    add_word_aux('d', 0);
+    tape_.push_back(bits);
+    return true;
+  }
+
+  bool handle_string(const std::string& str) {
+    add_word_aux('s', add_string_aux(str));
+    return true;
+  }
+
+  bool handle_key(const std::string& key) {
+    add_word_aux('k', add_string_aux(key));
+    return true;
+  }
+
+  // freeze() 时紧凑数组整体写入（见 value::write_to()）
+  bool handle_int64_array(const int64_t* vals, size_t size) {
+    handle_start_array();
+    for(size_t i = 0; i < size; i++) {
+      if(vals[i] >= std::numeric_limits<int32_t>::min() && vals[i] <= std::numeric_limits<int32_t>::max())
+        handle_int32(static_cast<int32_t>(vals[i]));
+      else
+        handle_int64(vals[i]);
+    }
+    return handle_end_array();
+  }
+
+  bool handle_double_array(const double* vals, size_t size) {
+    handle_start_array();
+    for(size_t i = 0; i < size; i++)
+      handle_double(vals[i]);
+    return handle_end_array();
+  }
+
+  bool handle_start_object() {
+    add_word_aux('{', 0);
+    stack_.emplace_back(tape_.size() - 1);
+    return true;
+  }
+
+  bool handle_end_object() {
+    return end_container_aux('}');
+  }
+
+  bool handle_start_array() {
+    add_word_aux('[', 0);
+    stack_.emplace_back(tape_.size() - 1);
+    return true;
+  }
+
+  bool handle_end_array() {
+    return end_container_aux(']');
+  }
+
+private:
+  // level 表示一个未结束的 array / object：'[' / '{' 的下标以及已有的元素个数
+  struct level {
+  public:
+    explicit level(size_t start) :
+      start_(start),
+      count_(0) {}
+
+  public:
+    size_t start_;
+    uint64_t count_;
+  };
+
+  void reset_aux() {
+    tape_.clear();
+    strings_.clear();
+    stack_.clear();
+    after_key_ = false;
+  }
+
+  // 'k' 之后的 value 不单独计数，其余的 value 都使所在的 array / object 的元素个数加 1
+  void add_word_aux(char tag, uint64_t payload) {
+    if(!stack_.empty() && !after_key_)
+      stack_.back().count_++;
+    after_key_ = tag == 'k';
+    tape_.push_back((static_cast<uint64_t>(static_cast<unsigned char>(tag)) << 56) | payload);
+  }
+
+  uint64_t add_string_aux(const std::string& str) {
+    assert(str.size() <= std::numeric_limits<uint32_t>::max());
+    uint64_t offset = strings_.size();
+    uint32_t length = static_cast<uint32_t>(str.size());
+    strings_.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    strings_.append(str);
+    strings_.push_back('\0');
+    return offset;
+  }
+
+  bool end_container_aux(char tag) {
+    assert(!stack_.empty());
+    auto top = stack_.back();
+    stack_.pop_back();
+    assert(tape_.size() <= std::numeric_limits<uint32_t>::max() && "tape too large");
+    uint64_t count = top.count_ < TAPE_MAX_COUNT ? top.count_ : TAPE_MAX_COUNT;
+    tape_[top.start_] |= (count << 32) | tape_.size();
+    tape_.push_back((static_cast<uint64_t>(tag) << 56) | top.start_);
+    return true;
+  }
+
+private:
+  std::vector<uint64_t> tape_;
+  std::string strings_;
+  std::vector<level> stack_;
+  bool after_key_ = false; // 为 true 表示上一个 word 为 'k'
+  reader_context context_;
+};
+
+value_type tape_cursor::get_type() const {
+  switch(tag_aux()) {
+    case 'n':
+      return TYPE_NULL;
+    case 't':
+    case 'f':
+      return TYPE_BOOL;
+    case 'i':
+      return TYPE_INT32;
+    case 'l':
+      return TYPE_INT64;
+    case 'd':
+      return TYPE_DOUBLE;
+    case '[':
+      return TYPE_ARRAY;
+    case '{':
+      return TYPE_OBJECT;
+    default:
+      return TYPE_STRING;
+  }
+}
+
+size_t tape_cursor::get_size() const {
+  if(!is_array() && !is_object())
+    return 1;
+  uint64_t count = payload_aux() >> 32;
+  if(count < TAPE_MAX_COUNT)
+    return static_cast<size_t>(count);
+  count = 0;
+  for(tape_cursor iter = first(); iter.is_valid(); iter = iter.next())
+    count++;
+  return static_cast<size_t>(count);
+}
+
+int64_t tape_cursor::get_int64_value() const {
+  assert(is_int64() || is_int32());
+  if(is_int32())
+    return get_int32_value();
+  return static_cast<int64_t>(word_aux(idx_ + 1));
+}
+
+double tape_cursor::get_double_value() const {
+  assert(is_double());
+  uint64_t bits = word_aux(idx_ + 1);
+  double val;
+  memcpy(&val, &bits, sizeof(val));
+  return val;
+}
+
+std::string_view tape_cursor::get_string_value() const {
+  assert(is_string());
+  return get_string_aux();
+}
+
+tape_cursor tape_cursor::first() const {
+  assert(is_array() || is_object());
+  char tag = static_cast<char>(word_aux(idx_ + 1) >> 56);
+  if(tag == ']' || tag == '}')
+    return tape_cursor();
+  return tape_cursor(tape_, strings_, idx_ + 1);
+}
+
+tape_cursor tape_cursor::next() const {
+  // root 总是位于下标 0，它没有兄弟结点，并且其之后就是 tape 的末尾
+  if(idx_ == 0)
+    return tape_cursor();
+  size_t idx = skip_aux(idx_);
+  char tag = static_cast<char>(word_aux(idx) >> 56);
+  if(tag == ']' || tag == '}')
+    return tape_cursor();
+  return tape_cursor(tape_, strings_, idx);
+}
+
+tape_cursor tape_cursor::find_element(std::string_view key) const {
+  assert(is_object());
+  for(tape_cursor iter = first(); iter.is_valid(); iter = iter.next()) {
+    if(iter.get_key() == key)
+      return iter;
+  }
+  return tape_cursor();
+}
+
+template <typename Handler>
+bool tape_cursor::write_to(Handler& handler) const {
+  switch(tag_aux()) {
+    case 'n':
+      return handler.handle_null();
+    case 't':
+    case 'f':
+      return handler.handle_bool(get_bool_value());
+    case 'i':
+      return handler.handle_int32(get_int32_value());
+    case 'l':
+      return handler.handle_int64(get_int64_value());
+    case 'd':
+      return handler.handle_double(get_double_value());
+    case 's':
+      return handler.handle_string(std::string(get_string_value()));
+    case '[':
+      if(!handler.handle_start_array())
+        return false;
+      for(tape_cursor iter = first(); iter.is_valid(); iter = iter.next()) {
+        if(!iter.write_to(handler))
+          return false;
+      }
+      return handler.handle_end_array();
+    case '{':
+      if(!handler.handle_start_object())
+        return false;
+      for(tape_cursor iter = first(); iter.is_valid(); iter = iter.next()) {
+        if(!handler.handle_key(std::string(iter.get_key())) || !iter.get_value().write_to(handler))
+          return false;
+      }
+      return handler.handle_end_object();
+    default:
+      assert(false && "bad tape");
+      return false;
+  }
+}
+
+}
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef _TASK_POOL_H_
+#define _TASK_POOL_H_
+
+#include <cstddef>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace json2 {
+
+/*
+ * task_pool 类：一个简单的 work-stealing 线程池，用于并行解析（见 ndjson.h）
+ *      run(count, task) 会将编号为 [0, count) 的任务按连续的区间平均分给每个 worker，
+ *      每个 worker 从自己队列的头部取任务；自己的队列为空时，再从其他 worker 队列的尾部“偷”任务。
+ *      这样相邻的任务大多由同一个线程处理，而处理较慢的 worker 剩下的任务会被空闲的 worker 分担。
+ *
+ *  task 抛出异常时，所有 worker 不再领取新的任务，run() 等待所有线程结束之后再将第一个异常抛给调用者。
+ *
+ *  注：每个任务应当是粗粒度的（例如 1MB 的 chunk），所以每个队列只用一把 mutex 保护即可
+ */
+class task_pool {
+public:
+  task_pool(const task_pool&) = delete;
+  task_pool& operator=(const task_pool&) = delete;
+
+  // threads 为 0 时，使用 std::thread::hardware_concurrency() 个线程
+  explicit task_pool(unsigned threads = 0) :
+    size_(threads > 0 ? threads : std::thread::hardware_concurrency()) {
+    if(size_ == 0)
+      size_ = 1;
+  }
+
+  unsigned size() const {
+    return size_;
+  }
+
+  // 并行执行 task(worker, idx)，其中 worker ∈ [0, size())，idx ∈ [0, count)
+  // 调用线程本身作为 0 号 worker，run() 会阻塞直到所有任务执行完（或某个 task 抛出异常）
+  template <typename Task>
+  void run(size_t count, Task task) {
+    std::vector<queue> queues(size_);
+    for(unsigned i = 0; i < size_; i++) {
+      size_t first = count * i / size_;
+      size_t last = count * (i + 1) / size_;
+      for(size_t idx = first; idx < last; idx++)
+        queues[i].tasks_.push_back(idx);
+    }
+
+    // 异常不能离开 worker 线程（否则 std::terminate），先记录下来，由调用线程在 join 之后重新抛出
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    std::atomic<bool> failed(false);
+    auto work = [&](unsigned worker) {
+      size_t idx;
+      while(!failed.load(std::memory_order_relaxed) && pop_aux(queues, worker, idx)) {
+        try {
+          task(worker, idx);
+        } catch(...) {
+          std::lock_guard<std::mutex> lock(error_mutex);
+          if(!error)
+            error = std::current_exception();
+          failed.store(true);
+        }
+      }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(size_ - 1);
+    for(unsigned i = 1; i < size_; i++)
+      threads.emplace_back(work, i);
+    work(0);
+    for(auto& thread : threads)
+      thread.join();
+    if(error)
+      std::rethrow_exception(error);
+  }
+
+private:
+  struct queue {
+    std::mutex mutex_;
+    std::deque<size_t> tasks_;
+  };
+
+  // 先从自己的队列头部取任务，取不到时再依次从其他队列的尾部偷
+  bool pop_aux(std::vector<queue>& queues, unsigned worker, size_t& idx) {
+    {
+      auto& own = queues[worker];
+      std::lock_guard<std::mutex> lock(own.mutex_);
+      if(!own.tasks_.empty()) {
+        idx = own.tasks_.front();
+        own.tasks_.pop_front();
+        return true;
+      }
+    }
+    for(unsigned i = 1; i < size_; i++) {
+      auto& victim = queues[(worker + i) % size_];
+      std::lock_guard<std::mutex> lock(victim.mutex_);
+      if(!victim.tasks_.empty()) {
+        idx = victim.tasks_.back();
+        victim.tasks_.pop_back();
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  unsigned size_;
+};
+
+}
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef _TEE_HANDLER_H_
+#define _TEE_HANDLER_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "value.h"
+#include "reader.h"
+
+namespace json2 {
+
+/**
+ * @description: tee_handler 将收到的每个事件依次转发给它的所有子 handler，
+ *      因此一次解析就可以同时得到多个结果，例如同时构建 DOM 并重新序列化：
+ *  ```
+ *    document doc;
+ *    string_write_stream out;
+ *    writer<string_write_stream> w(out);
+ *    tee_handler tee(doc, w);
+ *    parse_error err = reader::parse(in, tee);
+ *  ```
+ *  - 子 handler 以引用的方式保存，按模板参数的顺序调用；所有的转发都是静态分发的（fold expression），
+ *    没有虚函数调用，编译器可以将整个 tee_handler 完全内联
+ *  - 某个子 handler 返回 false 时，之后的子 handler 不再收到该事件，tee_handler 也返回 false，
+ *    即 reader 会以 PARSE_USER_STOPPED 停止解析
+ *  - string 和 key 以 const std::string& 转发，所有子 handler 共享 reader 中的同一个 buffer，
+ *    只有按值接收 std::string 的子 handler 才会拷贝
+ *  - handle_uint64() 对每个子 handler 分别处理（见 dispatch_uint64()）；handle_raw_number() 以及紧凑数组的
+ *    handle_int64_array() / handle_double_array() 只有在所有子 handler 都支持时才会提供，
+ *    否则 value::write_to() 会像对待普通的 handler 一样转换之后发送
+ *  - skip_next_value() 不会转发：只有所有子 handler 都跳过时才能跳过，而询问本身会改变某些子 handler 的状态
+ */
+template <typename... Handlers>
+class tee_handler {
+  static_assert(sizeof...(Handlers) > 0, "tee_handler needs at least one handler");
+
+  // 用于只在所有子 handler 都支持时才提供的事件
+  template <template <typename, typename> class Trait, typename T>
+  using if_all = std::enable_if_t<(Trait<Handlers, void>::value && ...), T>;
+
+public:
+  tee_handler(const tee_handler&) = delete;
+  tee_handler& operator=(const tee_handler&) = delete;
+
+  explicit tee_handler(Handlers&... handlers) :
+    handlers_(handlers...) {}
+
+  bool handle_null() {
+    return std::apply([](auto&... h) { return (h.handle_null() && ...); }, handlers_);
+  }
+
+  bool handle_bool(bool val) {
+    return std::apply([val](auto&... h) { return (h.handle_bool(val) && ...); }, handlers_);
+  }
+
+  bool handle_int32(int32_t val) {
+    return std::apply([val](auto&... h) { return (h.handle_int32(val) && ...); }, handlers_);
+  }
+
+  bool handle_int64(int64_t val) {
+    return std::apply([val](auto&... h) { return (h.handle_int64(val) && ...); }, handlers_);
+  }
+
+  bool handle_uint64(uint64_t val) {
+    return std::apply([val](auto&... h) { return (dispatch_uint64(h, val) && ...); }, handlers_);
+  }
+
+  bool handle_double(double val) {
+    return std::apply([val](auto&... h) { return (h.handle_double(val) && ...); }, handlers_);
+  }
+
+  bool handle_string(const std::string& str) {
+    return std::apply([&str](auto&... h) { return (h.handle_string(str) && ...); }, handlers_);
+  }
+
+  bool handle_key(const std::string& key) {
+    return std::apply([&key](auto&... h) { return (h.handle_key(key) && ...); }, handlers_);
+  }
+
+  bool handle_start_object() {
+    return std::apply([](auto&... h) { return (h.handle_start_object() && ...); }, handlers_);
+  }
+
+  bool handle_end_object() {
+    return std::apply([](auto&... h) { return (h.handle_end_object() && ...); }, handlers_);
+  }
+
+  bool handle_start_array() {
+    return std::apply([](auto&... h) { return (h.handle_start_array() && ...); }, handlers_);
+  }
+
+  bool handle_end_array() {
+    return std::apply([](auto&... h) { return (h.handle_end_array() && ...); }, handlers_);
+  }
+
+  template <typename T = bool>
+  if_all<has_raw_number_handler, T> handle_raw_number(std::string_view raw) {
+    return std::apply([raw](auto&... h) { return (h.handle_raw_number(raw) && ...); }, handlers_);
+  }
+
+  // 只在 PARSE_FLAG_RAW 时使用，不支持的子 handler 与直接交给 reader 时一样在编译时报错
+  bool handle_raw_string(const std::string& raw) {
+    return std::apply([&raw](auto&... h) { return (h.handle_raw_string(raw) && ...); }, handlers_);
+  }
+
+  bool handle_raw_key(const std::string& raw) {
+    return std::apply([&raw](auto&... h) { return (h.handle_raw_key(raw) && ...); }, handlers_);
+  }
+
+  template <typename T = bool>
+  if_all<has_packed_array_handler, T> handle_int64_array(const int64_t* vals, size_t size) {
+    return std::apply([=](auto&... h) { return (h.handle_int64_array(vals, size) && ...); }, handlers_);
+  }
+
+  template <typename T = bool>
+  if_all<has_packed_array_handler, T> handle_double_array(const double* vals, size_t size) {
+    return std::apply([=](auto&... h) { return (h.handle_double_array(vals, size) && ...); }, handlers_);
+  }
+
+private:
+  std::tuple<Handlers&...> handlers_;
+};
+
+}
+
+#endif
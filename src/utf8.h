@@ -0,0 +1,88 @@
+#ifndef _UTF8_H_
+#define _UTF8_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace json2 {
+
+/**
+ * @description: 合法的多字节 UTF-8 字符（见 Unicode 标准 Table 3-7）：
+ *
+ *    字节1        字节2        字节3        字节4
+ *    C2..DF      80..BF
+ *    E0          A0..BF      80..BF
+ *    E1..EC      80..BF      80..BF
+ *    ED          80..9F      80..BF                   // 排除代理项 U+D800 ~ U+DFFF
+ *    EE..EF      80..BF      80..BF
+ *    F0          90..BF      80..BF      80..BF       // 排除过长（overlong）的编码
+ *    F1..F3      80..BF      80..BF      80..BF
+ *    F4          80..8F      80..BF      80..BF       // 不超过 U+10FFFF
+ *
+ *  除第 2 个字节外，其余后续字节的范围都是 80..BF。
+ *  utf8_trail_count() 返回首字节 lead 之后的字节个数，并通过 low / high 返回第 2 个字节的合法范围；
+ *  lead 不能作为首字节（如 80..C1、F5..FF）时返回 0
+ */
+inline unsigned utf8_trail_count(unsigned char lead, unsigned char& low, unsigned char& high) {
+  low = 0x80;
+  high = 0xBF;
+  if(lead >= 0xC2 && lead <= 0xDF)
+    return 1;
+  if(lead >= 0xE0 && lead <= 0xEF) {
+    if(lead == 0xE0)
+      low = 0xA0;
+    else if(lead == 0xED)
+      high = 0x9F;
+    return 2;
+  }
+  if(lead >= 0xF0 && lead <= 0xF4) {
+    if(lead == 0xF0)
+      low = 0x90;
+    else if(lead == 0xF4)
+      high = 0x8F;
+    return 3;
+  }
+  return 0;
+}
+
+/**
+ * @description: 校验 [data, data + size) 是否为合法的 UTF-8。
+ *      每次读取 8 个字节，8 个字节全部为 ASCII（最高位都为 0）时整体跳过，
+ *      只有遇到非 ASCII 字节时才逐个字符地校验，因此对以 ASCII 为主的输入几乎没有额外开销。
+ *
+ *  reader 在开启 PARSE_FLAG_VALIDATE_UTF8 时会在解析 string 的同时校验，不需要单独调用此函数；
+ *  此函数用于在解析之前校验整块输入（例如不经过 reader 的数据）
+ */
+inline bool validate_utf8(const char* data, size_t size) {
+  const unsigned char* iter = reinterpret_cast<const unsigned char*>(data);
+  const unsigned char* end = iter + size;
+  while(iter != end) {
+    if(end - iter >= 8) {
+      uint64_t word;
+      memcpy(&word, iter, sizeof(word));
+      if((word & 0x8080808080808080ULL) == 0) {
+        iter += 8;
+        continue;
+      }
+    }
+    unsigned char lead = *iter++;
+    if(lead < 0x80)
+      continue;
+    unsigned char low, high;
+    unsigned count = utf8_trail_count(lead, low, high);
+    if(count == 0 || static_cast<size_t>(end - iter) < count)
+      return false;
+    for(unsigned i = 0; i < count; i++, iter++) {
+      if(*iter < low || *iter > high)
+        return false;
+      low = 0x80;
+      high = 0xBF;
+    }
+  }
+  return true;
+}
+
+}
+
+#endif
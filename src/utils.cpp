@@ -204,4 +204,8 @@ unsigned fast_itoa(int64_t val, char* buf) {
     return (val < 0) + itoa_aux(num, buf);   
 }
 
+unsigned fast_itoa(uint64_t val, char* buf) {
+    return itoa_aux(val, buf);
+}
+
 }
\ No newline at end of file
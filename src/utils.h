@@ -15,6 +15,7 @@ namespace json2 {
 
 unsigned fast_itoa(int32_t val, char* buf);
 unsigned fast_itoa(int64_t val, char* buf);   
+unsigned fast_itoa(uint64_t val, char* buf);
 
 }
 
@@ -1,3 +1,5 @@
+#include <cerrno>
+#include <cstdlib>
 #include "value.h"
 
 namespace json2 {
@@ -15,11 +17,21 @@ value::value(value_type type) :
     case TYPE_DOUBLE:
       break;
     case TYPE_STRING:
+    case TYPE_NUMBER:
       string_value_ = new string_with_refcount(); 
+      break;
     case TYPE_ARRAY:
       array_value_ = new array_with_refcount(); 
+      break;
     case TYPE_OBJECT:
       object_value_ = new object_with_refcount();
+      break;
+    case TYPE_INT64_ARRAY:
+      int64_array_value_ = new int64_array_with_refcount();
+      break;
+    case TYPE_DOUBLE_ARRAY:
+      double_array_value_ = new double_array_with_refcount();
+      break;
     default:
       assert(false && "incorrect value type!");
   } 
@@ -39,6 +51,7 @@ value::value(const value& rhs) :
     // 对于以下三种复杂类型，由于它们本身带有 refcount，
     // 所以以别的 json 对象直接拷贝构造当前对象时，需要将 refcount 的值加 1
     case TYPE_STRING:
+    case TYPE_NUMBER:
       string_value_->increment_and_get();
       break;
     case TYPE_ARRAY:
@@ -47,6 +60,12 @@ value::value(const value& rhs) :
     case TYPE_OBJECT:
       object_value_->increment_and_get();
       break;
+    case TYPE_INT64_ARRAY:
+      int64_array_value_->increment_and_get();
+      break;
+    case TYPE_DOUBLE_ARRAY:
+      double_array_value_->increment_and_get();
+      break;
     default:
       assert(false && "incorrect value type!"); 
   }
@@ -76,6 +95,7 @@ value& value::operator=(const value& rhs) {
       break;
 
     case TYPE_STRING:
+    case TYPE_NUMBER:
       string_value_->increment_and_get();
       break;
     case TYPE_ARRAY:
@@ -84,6 +104,12 @@ value& value::operator=(const value& rhs) {
     case TYPE_OBJECT:
       object_value_->increment_and_get();
       break;
+    case TYPE_INT64_ARRAY:
+      int64_array_value_->increment_and_get();
+      break;
+    case TYPE_DOUBLE_ARRAY:
+      double_array_value_->increment_and_get();
+      break;
     default:
       assert(false && "incorrect value type");
   }
@@ -110,17 +136,26 @@ value::~value() {
     case TYPE_DOUBLE:
       break;
     case TYPE_STRING:
+    case TYPE_NUMBER:
       if(string_value_->decrement_and_get() == 0)
         delete string_value_;
       break;
     case TYPE_ARRAY:
-      if(array_value_->decrement_and_get())
+      if(array_value_->decrement_and_get() == 0)
         delete array_value_;
       break;
     case TYPE_OBJECT:
-      if(object_value_->decrement_and_get())
+      if(object_value_->decrement_and_get() == 0)
         delete object_value_;
       break;
+    case TYPE_INT64_ARRAY:
+      if(int64_array_value_->decrement_and_get() == 0)
+        delete int64_array_value_;
+      break;
+    case TYPE_DOUBLE_ARRAY:
+      if(double_array_value_->decrement_and_get() == 0)
+        delete double_array_value_;
+      break;
     default:
       assert(false && "incorrect value type!");
   }
@@ -175,13 +210,67 @@ const value& value::operator[] (std::string key) const {
   return const_cast<value&>(*this)[key]; 
 }
 
+value& value::unpack_array() {
+  assert(is_packed_array());
+  std::vector<value> values;
+  values.reserve(get_size());
+  if(type_ == TYPE_INT64_ARRAY) {
+    for(int64_t val : int64_array_value_->data_) {
+      if(val >= std::numeric_limits<int32_t>::min() &&
+         val <= std::numeric_limits<int32_t>::max())
+        values.emplace_back(static_cast<int32_t>(val));
+      else
+        values.emplace_back(val);
+    }
+  } else {
+    for(double val : double_array_value_->data_)
+      values.emplace_back(val);
+  }
+  set_array();
+  array_value_->data_.swap(values);
+  return *this;
+}
+
+bool value::raw_number_is_int64_aux(int64_t& val) const {
+  assert(type_ == TYPE_NUMBER);
+  // 原始文本不以 '\0' 结尾，需要先拷贝一份才能交给 strtoll()
+  std::string text(string_value_->data_.begin(), string_value_->data_.end());
+  if(text.find_first_of(".eE") != std::string::npos)
+    return false;
+  errno = 0;
+  long long ret = strtoll(text.c_str(), nullptr, 10);
+  if(errno == ERANGE)
+    return false;
+  val = static_cast<int64_t>(ret);
+  return true;
+}
+
+// 与其他类型的 getter 一样，不是 int64_t 的数字视为类型不符，不截断也不饱和
+int64_t value::raw_number_to_int64_aux() const {
+  int64_t val = 0;
+  bool is_int64 = raw_number_is_int64_aux(val);
+  assert(is_int64 && "raw number is not an integer in int64_t range");
+  (void)is_int64;
+  return val;
+}
+
+double value::raw_number_to_double_aux() const {
+  assert(type_ == TYPE_NUMBER);
+  std::string text(string_value_->data_.begin(), string_value_->data_.end());
+  return strtod(text.c_str(), nullptr);
+}
+
+// 通过下标访问紧凑数组时，需要先将其展开，才能返回元素的引用
 value& value::operator[] (size_t idx) {
+  if(is_packed_array())
+    unpack_array();
   assert(type_ == TYPE_ARRAY);
   return array_value_->data_[idx];
 }
 
+// const 的紧凑数组无法展开，只能通过 get_int64_array_value() / get_double_array_value() 访问
 const value& value::operator[] (size_t idx) const {
-  assert(type_ == TYPE_ARRAY);
+  assert(type_ == TYPE_ARRAY && "packed array: call unpack_array() first");
   return array_value_->data_[idx];
 }
 
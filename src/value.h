@@ -4,10 +4,15 @@
 #include <cassert>
 #include <cstring>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
 #include <algorithm>
 #include <atomic>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <utility>
 
 namespace json2 {
 
@@ -99,7 +104,13 @@ enum value_type {
   TYPE_STRING,
   TYPE_ARRAY,
   TYPE_OBJECT,
-};;
+  // 以下两种为紧凑（packed）数组：元素全部为整数或全部为浮点数的 array，
+  // 以连续的 int64_t[] / double[] 存储，而不是每个元素一个 value
+  TYPE_INT64_ARRAY,
+  TYPE_DOUBLE_ARRAY,
+  // 未转换的数字，只保存其原始文本（见 PARSE_FLAG_RAW_NUMBER），读取时才转换为数值
+  TYPE_NUMBER,
+};
 
 struct element;
 class document;
@@ -180,6 +191,15 @@ public:
 
   explicit value(const char* str, size_t len) :
     value(std::string(str, len)) {}
+
+  // 以下两种为紧凑数组的构造，主要由 document 在检测到同质的数字 array 时使用
+  explicit value(std::vector<int64_t> int64_array) :
+    type_(TYPE_INT64_ARRAY),
+    int64_array_value_(new int64_array_with_refcount(std::move(int64_array))) {}
+
+  explicit value(std::vector<double> double_array) :
+    type_(TYPE_DOUBLE_ARRAY),
+    double_array_value_(new double_array_with_refcount(std::move(double_array))) {}
  
   value(const value& rhs);
   value(value&& rhs);
@@ -198,6 +218,10 @@ public:
       return array_value_->data_.size();
     else if(type_ == TYPE_OBJECT)
       return object_value_->data_.size();
+    else if(type_ == TYPE_INT64_ARRAY)
+      return int64_array_value_->data_.size();
+    else if(type_ == TYPE_DOUBLE_ARRAY)
+      return double_array_value_->data_.size();
     return 1;
   }
 
@@ -225,8 +249,23 @@ public:
     return type_ == TYPE_STRING; 
   }
 
+  bool is_raw_number() const {
+    return type_ == TYPE_NUMBER;
+  }
+
+  // TYPE_NUMBER 的原始文本是否为 int64_t 范围内的整数，即能否调用 get_int64_value()
+  bool is_raw_integer() const {
+    int64_t val;
+    return type_ == TYPE_NUMBER && raw_number_is_int64_aux(val);
+  }
+
+  // 紧凑数组在 json 语义上也是 array
   bool is_array() const {
-    return type_ == TYPE_ARRAY; 
+    return type_ == TYPE_ARRAY || is_packed_array(); 
+  }
+
+  bool is_packed_array() const {
+    return type_ == TYPE_INT64_ARRAY || type_ == TYPE_DOUBLE_ARRAY;
   }
 
   bool is_object() const {
@@ -252,9 +291,15 @@ public:
     return *new(this) value(bool_value);
   }
 
+  // TYPE_NUMBER 必须是 int32_t 范围内的整数，否则与类型不符一样 assert 失败
   int32_t get_int32_value() const {
-    assert(type_ == TYPE_INT32);
-    return int32_value_;
+    assert(type_ == TYPE_INT32 || type_ == TYPE_NUMBER);
+    if(type_ == TYPE_INT32)
+      return int32_value_;
+    int64_t val = raw_number_to_int64_aux();
+    assert(val >= std::numeric_limits<int32_t>::min() && val <= std::numeric_limits<int32_t>::max() &&
+           "raw number out of int32_t range");
+    return static_cast<int32_t>(val);
   }
 
   value& set_int32_value(int32_t int32_value) {
@@ -263,8 +308,10 @@ public:
   }
   
   int64_t get_int64_value() const {
-    // 对于 int32_t 类型的值也可以在此处返回
-    assert(type_ == TYPE_INT64 || type_ == TYPE_INT32);
+    // 对于 int32_t 类型的值也可以在此处返回；TYPE_NUMBER 必须是 int64_t 范围内的整数（见 is_raw_integer()）
+    assert(type_ == TYPE_INT64 || type_ == TYPE_INT32 || type_ == TYPE_NUMBER);
+    if(type_ == TYPE_NUMBER)
+      return raw_number_to_int64_aux();
     return type_ == TYPE_INT64 ? int64_value_ : int32_value_;
   }
   
@@ -274,8 +321,8 @@ public:
   }
 
   double get_double_value() const {
-    assert(type_ == TYPE_DOUBLE);
-    return double_value_;
+    assert(type_ == TYPE_DOUBLE || type_ == TYPE_NUMBER);
+    return type_ == TYPE_DOUBLE ? double_value_ : raw_number_to_double_aux();
   }
 
   value& set_double(double double_value) {
@@ -295,8 +342,23 @@ public:
     return *new(this) value(str);
   }
 
+  // 原始文本必须是合法的 json 数字，在调用 get_int64_value() / get_double_value() 时才会转换，
+  // write_to() 时原样发送给 handle_raw_number()，因此任意精度的数字都不会有损失
+  std::string_view get_raw_number() const {
+    assert(type_ == TYPE_NUMBER);
+    return std::string_view(string_value_->data_.data(), string_value_->data_.size());
+  }
+
+  value& set_raw_number(std::string_view text) {
+    this->~value();
+    new(this) value(TYPE_NUMBER);
+    string_value_->data_.assign(text.begin(), text.end());
+    return *this;
+  }
+
+  // 紧凑数组没有 value 形式的元素，需要先 unpack_array()，或使用 get_int64_array_value() 等
   const auto& get_array_value() const {
-    assert(type_ == TYPE_ARRAY);
+    assert(type_ == TYPE_ARRAY && "packed array: call unpack_array() first");
     return array_value_->data_;
   }
 
@@ -304,6 +366,20 @@ public:
     this->~value();
     return *new(this) value(TYPE_ARRAY);
   }
+
+  const std::vector<int64_t>& get_int64_array_value() const {
+    assert(type_ == TYPE_INT64_ARRAY);
+    return int64_array_value_->data_;
+  }
+
+  const std::vector<double>& get_double_array_value() const {
+    assert(type_ == TYPE_DOUBLE_ARRAY);
+    return double_array_value_->data_;
+  }
+
+  // 将紧凑数组展开为普通的 TYPE_ARRAY，即每个元素一个 value
+  // 整数元素能放入 int32_t 的展开为 TYPE_INT32，否则为 TYPE_INT64，与 reader 的选择一致
+  value& unpack_array();
   
   const auto& get_object_value() const {
     assert(type_ == TYPE_OBJECT);
@@ -349,6 +425,8 @@ public:
 
   template <typename Value>
   value& add_value(Value&& val) {
+    if(is_packed_array())
+      unpack_array();
     assert(type_ == TYPE_ARRAY);
     array_value_->data_.emplace_back(std::forward<Value>(val));
     return array_value_->data_.back();
@@ -360,12 +438,30 @@ public:
   value& operator[] (size_t idx);
   const value& operator[] (size_t idx) const;
 
+  // 将 value 以事件的形式依次发送给 handler（例如 writer），即 DOM -> SAX
+  // 若 handler 提供了 handle_int64_array() / handle_double_array()，紧凑数组会整体发送，
+  // 否则按普通 array 逐个元素发送
+  // 注：write_to() 对每一层 array / object 递归一次，并不像 reader 那样是迭代的；
+  // handler 抛出的异常（如 writer 超过 max_depth 时的 json_exception(PARSE_DEPTH_EXCEEDED)）直接抛给调用者
+  template <typename Handler>
+  bool write_to(Handler& handler) const;
+
+private:
+  // 转换 TYPE_NUMBER 的原始文本：
+  //  - raw_number_is_int64_aux() 只转换在 int64_t 范围内的整数，否则返回 false
+  //  - raw_number_to_int64_aux() 只接受 int64_t 范围内的整数，其他数字（小数、超出范围的整数）assert 失败
+  bool raw_number_is_int64_aux(int64_t& val) const;
+  int64_t raw_number_to_int64_aux() const;
+  double raw_number_to_double_aux() const;
+
 private:
   value_type type_;
   
   using string_with_refcount = refcount<std::vector<char>>; 
   using array_with_refcount = refcount<std::vector<value>>;
   using object_with_refcount = refcount<std::vector<element>>;
+  using int64_array_with_refcount = refcount<std::vector<int64_t>>;
+  using double_array_with_refcount = refcount<std::vector<double>>;
 
   union {
     bool bool_value_;
@@ -375,7 +471,8 @@ private:
     string_with_refcount* string_value_;
     array_with_refcount* array_value_;
     object_with_refcount* object_value_;
-  
+    int64_array_with_refcount* int64_array_value_;
+    double_array_with_refcount* double_array_value_;
   };
 
 };
@@ -397,6 +494,104 @@ public:
     value value_;
 };
 
+// 用于检测 Handler 是否支持整体接收紧凑数组
+template <typename Handler, typename = void>
+struct has_packed_array_handler : std::false_type {};
+
+template <typename Handler>
+struct has_packed_array_handler<Handler, std::void_t<
+    decltype(std::declval<Handler&>().handle_int64_array(std::declval<const int64_t*>(), size_t())),
+    decltype(std::declval<Handler&>().handle_double_array(std::declval<const double*>(), size_t()))>> :
+  std::true_type {};
+
+// 用于检测 Handler 是否支持接收未转换的数字（如 writer）
+template <typename Handler, typename = void>
+struct has_raw_number_handler : std::false_type {};
+
+template <typename Handler>
+struct has_raw_number_handler<Handler, std::void_t<
+    decltype(std::declval<Handler&>().handle_raw_number(std::string_view()))>> :
+  std::true_type {};
+
+template <typename Handler>
+bool value::write_to(Handler& handler) const {
+  switch(type_) {
+    case TYPE_NULL:
+      return handler.handle_null();
+    case TYPE_BOOL:
+      return handler.handle_bool(bool_value_);
+    case TYPE_INT32:
+      return handler.handle_int32(int32_value_);
+    case TYPE_INT64:
+      return handler.handle_int64(int64_value_);
+    case TYPE_DOUBLE:
+      return handler.handle_double(double_value_);
+    case TYPE_STRING:
+      return handler.handle_string(get_string_value());
+    case TYPE_NUMBER:
+      if constexpr (has_raw_number_handler<Handler>::value) {
+        return handler.handle_raw_number(get_raw_number());
+      } else {
+        // handler 不支持 handle_raw_number() 时只能转换之后发送
+        int64_t val;
+        if(!raw_number_is_int64_aux(val))
+          return handler.handle_double(raw_number_to_double_aux());
+        if(val >= std::numeric_limits<int32_t>::min() && val <= std::numeric_limits<int32_t>::max())
+          return handler.handle_int32(static_cast<int32_t>(val));
+        return handler.handle_int64(val);
+      }
+    case TYPE_ARRAY:
+      if(!handler.handle_start_array())
+        return false;
+      for(const auto& val : array_value_->data_) {
+        if(!val.write_to(handler))
+          return false;
+      }
+      return handler.handle_end_array();
+    case TYPE_OBJECT:
+      if(!handler.handle_start_object())
+        return false;
+      for(const auto& elem : object_value_->data_) {
+        if(!handler.handle_key(elem.key_.get_string_value()))
+          return false;
+        if(!elem.value_.write_to(handler))
+          return false;
+      }
+      return handler.handle_end_object();
+    case TYPE_INT64_ARRAY:
+    case TYPE_DOUBLE_ARRAY:
+      if constexpr (has_packed_array_handler<Handler>::value) {
+        if(type_ == TYPE_INT64_ARRAY)
+          return handler.handle_int64_array(int64_array_value_->data_.data(), 
+                                            int64_array_value_->data_.size());
+        return handler.handle_double_array(double_array_value_->data_.data(), 
+                                           double_array_value_->data_.size());
+      } else {
+        if(!handler.handle_start_array())
+          return false;
+        if(type_ == TYPE_INT64_ARRAY) {
+          for(int64_t val : int64_array_value_->data_) {
+            bool ok = (val >= std::numeric_limits<int32_t>::min() &&
+                       val <= std::numeric_limits<int32_t>::max()) ?
+                      handler.handle_int32(static_cast<int32_t>(val)) :
+                      handler.handle_int64(val);
+            if(!ok)
+              return false;
+          }
+        } else {
+          for(double val : double_array_value_->data_) {
+            if(!handler.handle_double(val))
+              return false;
+          }
+        }
+        return handler.handle_end_array();
+      }
+    default:
+      assert(false && "incorrect value type!");
+  }
+  return false;
+}
+
 }
 
 
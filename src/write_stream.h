@@ -37,6 +37,11 @@ public:
     fprintf(output_, "%.*s", static_cast<int>(str.length()), str.data());
   }
 
+  // 直接输出 str 开始的 len 个字节，主要用于 writer 批量输出
+  void dump(const char* str, size_t len) {
+    fwrite(str, 1, len, output_);
+  }
+
 private:
   FILE* output_;
 };
@@ -44,6 +49,7 @@ private:
 
 class string_write_stream {
 public:
+  string_write_stream() = default;
   string_write_stream(const string_write_stream&) = delete;
   string_write_stream& operator=(const string_write_stream&) = delete;
 
@@ -55,6 +61,10 @@ public:
     buffer_.insert(buffer_.end(), str.begin(), str.end());
   }
 
+  void dump(const char* str, size_t len) {
+    buffer_.insert(buffer_.end(), str, str + len);
+  }
+
   std::string get() const {
     return std::string(&*buffer_.begin(), buffer_.size());
   }
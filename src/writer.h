@@ -10,11 +10,17 @@
 #define _WRITER_H_ 
 
 #include <string>
+#include <string_view>
 #include <cstdint>
 #include <vector>
 #include <cassert>
 #include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+#include "exception.h"
 #include "value.h"
+#include "stats.h"
 #include "utils.h"
 
 namespace json2 {
@@ -44,6 +50,7 @@ template <typename WriteStream>
  *      bool hand_bool(bool b);
  *      bool handle_int32(int i);
  *      bool handle_int64(int64_t i);
+ *      bool handle_uint64(uint64_t i);     // 可选
  *      bool handle_double(double d);
  *      bool handle_string(const Ch* str, SizeType length, bool copy);
  *      bool handle_start_object();
@@ -57,6 +64,7 @@ template <typename WriteStream>
  *  当 Reader 遇到 JSON true 或 false 值时会调用 handle_bool(bool)。
  *  当 Reader 遇到 JSON number，它会选择一个合适的 C++ 类型映射，然后调用 handle_int(int)、
  *    、handle_int64(int64_t) 及 handle_double(double) 的其中之一个。 
+ *    超出 int64_t 范围的正整数会调用 handle_uint64(uint64_t)，handler 没有实现它时改为调用 handle_double()。
  *    
  *  当 Reader 遇到 JSON string，它会调用 handle_string(const char* str)。
  *  第一个参数是字符串的指针。第二个参数是字符串的长度（不包含空终止符号）。
@@ -85,21 +93,46 @@ public:
 
   writer(WriteStream& stream) :
     stream_(stream), 
-    see_value_(false) {}
+    see_value_(false),
+    max_depth_(1024) {}
+
+  // indent 非空时，输出带缩进和换行的 json（见 pretty_writter）
+  writer(WriteStream& stream, std::string indent) :
+    stream_(stream),
+    see_value_(false),
+    indent_(std::move(indent)),
+    max_depth_(1024) {}
+
+  // array / object 嵌套的层数超过 max_depth 时，与 reader 一样抛出 json_exception(PARSE_DEPTH_EXCEEDED)：
+  // 由 reader::parse() 驱动时，parse() 返回 PARSE_DEPTH_EXCEEDED；由 value::write_to() 等驱动时，
+  // 异常直接抛给调用者（见 value::write_to()）
+  void set_max_depth(size_t max_depth) {
+    max_depth_ = max_depth;
+  }
+
+#ifdef JSON2_ENABLE_STATS
+  // writer 只统计各类事件的次数以及嵌套的最大层数（见 stats.h）
+  stats& get_stats() {
+    return stats_;
+  }
+#endif
 
   bool handle_null() {
+    JSON2_STATS(stats_.null_count_++);
     handle_nested_aux(TYPE_NULL);
     stream_.dump("null");
     return true;
   }
 
   bool handle_bool(bool val) {
+    JSON2_STATS(stats_.bool_count_++);
     handle_nested_aux(TYPE_BOOL);
     stream_.dump(val ? "true" : "false");
     return true;    
   }
 
   bool handle_int32(int32_t val) {
+    JSON2_STATS(stats_.int32_count_++);
     handle_nested_aux(TYPE_INT32);
     // TODO:这个数值是否可变 
     char buf[11];
@@ -109,6 +142,7 @@ public:
   }
 
   bool handle_int64(int64_t val) {
+    JSON2_STATS(stats_.int64_count_++);
     handle_nested_aux(TYPE_INT64);
     // TODO:这个数值是否可变 
     char buf[20];
@@ -117,89 +151,109 @@ public:
     return true;
   }
 
+  bool handle_uint64(uint64_t val) {
+    JSON2_STATS(stats_.uint64_count_++);
+    handle_nested_aux(TYPE_INT64);
+    char buf[20];
+    unsigned count = fast_itoa(val, buf);
+    stream_.dump(std::string(buf, count));
+    return true;
+  }
+
   bool handle_double(double val) {
+    JSON2_STATS(stats_.double_count_++);
     handle_nested_aux(TYPE_DOUBLE);
     char buf[32];
-    if(std::isinf(val)) {
-      strcpy(buf, "Infinity");
-    } else if(std::isnan(val)) {
-      strcpy(buf, "NaN");
-    } else {
-      int num = sprintf(buf, "%.17g", val);
-      assert(num > 0 && num < 32);
-      // 如果不加 ".0" 的话，会损失类型信息
-      // e.g. "1.0" --> double 1 --> "1"
-      auto iter = std::find_if_not(buf, buf + num, isdigit);
-      if(iter == buf + num) {
-        strcat(buf, ".0;");
-      }
-    }
-    stream_.dump(buf);
+    unsigned count = format_double(val, buf);
+    stream_.dump(std::string(buf, count));
     return true;
   }
 
-  bool handle_string(std::string str) {
+  // 以下两个函数用于整体输出紧凑数组（见 value::write_to()）
+  // 所有元素先格式化到栈上的 buf 中，buf 快满时才调用一次 stream_.dump()，
+  // 避免了逐个元素构造 std::string 临时对象
+  bool handle_int64_array(const int64_t* vals, size_t size) {
+    JSON2_STATS(stats_.int64_count_ += size);
+    return handle_packed_array_aux(vals, size, [](int64_t val, char* buf) {
+      return fast_itoa(val, buf);
+    });
+  }
+
+  bool handle_double_array(const double* vals, size_t size) {
+    JSON2_STATS(stats_.double_count_ += size);
+    return handle_packed_array_aux(vals, size, [](double val, char* buf) {
+      return format_double(val, buf);
+    });
+  }
+
+  bool handle_string(const std::string& str) {
+    JSON2_STATS(stats_.string_count_++);
+    handle_nested_aux(TYPE_STRING);
+    write_string_aux(str);
+    return true;
+  }
+
+  // 以下三个函数用于转码模式（PARSE_FLAG_RAW，handle_raw_number() 也用于 PARSE_FLAG_RAW_NUMBER），raw 为输入中已经校验过的原始字节，
+  // 原样输出即可，不需要再次转义或格式化
+  bool handle_raw_string(const std::string& raw) {
+    JSON2_STATS(stats_.string_count_++);
     handle_nested_aux(TYPE_STRING);
     stream_.dump('"');
-    for(auto ch : str) {
-      auto val = static_cast<unsigned>(ch);
-      switch(val) {
-        case '\"':
-          // TODO:stream_.dump("\\"");
-          stream_.dump("\\\"");
-        case '\b':
-          stream_.dump("\\b");
-        case '\f':
-          stream_.dump("\\f");
-        case '\n':
-          stream_.dump("\\n");
-        case '\r':
-          stream_.dump("\\r");
-        case '\t':
-          stream_.dump("\\t");
-        case '\\':
-          stream_.dump("\\\\");
-        default:
-          if(val < 0x20) {
-            char buf[7];
-            snprintf(buf, 7, "\\u%04X", val);
-            stream_.dump(buf);
-          } else {
-            stream_.dump(val);
-          }
-          break; 
-      }
-    }
+    stream_.dump(raw.data(), raw.size());
     stream_.dump('"');
     return true;
   }
 
+  bool handle_raw_key(const std::string& raw) {
+    JSON2_STATS(stats_.key_count_++);
+    handle_nested_aux(TYPE_STRING);
+    stream_.dump('"');
+    stream_.dump(raw.data(), raw.size());
+    stream_.dump('"');
+    return true;
+  }
+
+  bool handle_raw_number(std::string_view raw) {
+    JSON2_STATS(stats_.raw_number_count_++);
+    handle_nested_aux(TYPE_DOUBLE);
+    stream_.dump(raw.data(), raw.size());
+    return true;
+  }
+
   bool handle_start_object() {
+    check_depth_aux();
     handle_nested_aux(TYPE_OBJECT);
+    JSON2_STATS(stats_.object_count_++);
+    JSON2_STATS(stats_.max_depth_ = std::max(stats_.max_depth_, stack_.size() + 1));
     //  由于处理的是 object，所以需要把 in_array_ 设置为 false
     stack_.emplace_back(false);
     stream_.dump('{');
     return true;
   }
 
-  bool handle_key(std::string key) {
+  bool handle_key(const std::string& key) {
+    JSON2_STATS(stats_.key_count_++);
     handle_nested_aux(TYPE_STRING);
-    stream_.dump('"');
-    stream_.dump(key);
-    stream_.dump('"');
+    write_string_aux(key);
     return true;
   }
 
   bool handle_end_object() {
     assert(!stack_.empty());
     assert(!stack_.back().in_array_);
+    bool empty = stack_.back().value_count_ == 0;
     stack_.pop_back();
+    if(!empty)
+      add_indent_aux();
     stream_.dump('}');
     return true;
   }
 
   bool handle_start_array() {
+    check_depth_aux();
     handle_nested_aux(TYPE_ARRAY);
+    JSON2_STATS(stats_.array_count_++);
+    JSON2_STATS(stats_.max_depth_ = std::max(stats_.max_depth_, stack_.size() + 1));
     stack_.emplace_back(true);
     stream_.dump('[');
     return true;
@@ -208,12 +262,123 @@ public:
   bool handle_end_array() {
     assert(!stack_.empty());
     assert(stack_.back().in_array_);
+    bool empty = stack_.back().value_count_ == 0;
     stack_.pop_back();
+    if(!empty)
+      add_indent_aux();
     stream_.dump(']');
     return true;
   }
   
 private:
+  // 将 val 格式化到 buf 中（buf 至少 32 字节），返回输出的长度
+  static unsigned format_double(double val, char* buf) {
+    if(std::isinf(val)) {
+      memcpy(buf, "Infinity", 8);
+      return 8;
+    } else if(std::isnan(val)) {
+      memcpy(buf, "NaN", 3);
+      return 3;
+    } 
+    int num = snprintf(buf, 32, "%.17g", val);
+    assert(num > 0 && num < 32);
+    // 如果不加 ".0" 的话，会损失类型信息
+    // e.g. "1.0" --> double 1 --> "1"
+    auto iter = std::find_if_not(buf + (buf[0] == '-'), buf + num, isdigit);
+    if(iter == buf + num) {
+      buf[num++] = '.';
+      buf[num++] = '0';
+    }
+    return static_cast<unsigned>(num);
+  }
+
+  // 输出带引号并转义之后的 str，string 和 key 都经过这里。
+  // 不需要转义的连续字节整段输出，只有遇到需要转义的字节时才单独处理
+  void write_string_aux(const std::string& str) {
+    stream_.dump('"');
+    const char* data = str.data();
+    size_t begin = 0;
+    for(size_t i = 0; i < str.size(); i++) {
+      auto val = static_cast<unsigned char>(data[i]);
+      const char* escape;
+      switch(val) {
+        case '\"':
+          escape = "\\\"";
+          break;
+        case '\\':
+          escape = "\\\\";
+          break;
+        case '\b':
+          escape = "\\b";
+          break;
+        case '\f':
+          escape = "\\f";
+          break;
+        case '\n':
+          escape = "\\n";
+          break;
+        case '\r':
+          escape = "\\r";
+          break;
+        case '\t':
+          escape = "\\t";
+          break;
+        default:
+          if(val >= 0x20)
+            continue;
+          escape = nullptr;
+          break;
+      }
+      if(i > begin)
+        stream_.dump(data + begin, i - begin);
+      if(escape != nullptr) {
+        stream_.dump(escape, 2);
+      } else {
+        char buf[7];
+        snprintf(buf, sizeof(buf), "\\u%04X", val);
+        stream_.dump(buf, 6);
+      }
+      begin = i + 1;
+    }
+    if(str.size() > begin)
+      stream_.dump(data + begin, str.size() - begin);
+    stream_.dump('"');
+  }
+
+  template <typename T, typename Format>
+  bool handle_packed_array_aux(const T* vals, size_t size, Format format) {
+    // 带缩进时，每个元素与普通 array 一样经过 handle_nested_aux()，单独一行输出
+    if(!indent_.empty()) {
+      if(!handle_start_array())
+        return false;
+      char buf[32];
+      for(size_t i = 0; i < size; i++) {
+        handle_nested_aux(std::is_floating_point<T>::value ? TYPE_DOUBLE : TYPE_INT64);
+        stream_.dump(buf, format(vals[i], buf));
+      }
+      return handle_end_array();
+    }
+    check_depth_aux();
+    handle_nested_aux(TYPE_ARRAY);
+    JSON2_STATS(stats_.array_count_++);
+    JSON2_STATS(stats_.max_depth_ = std::max(stats_.max_depth_, stack_.size() + 1));
+    // 每个元素最多 32 字节（包括 ','），buf 剩余空间不足时先输出
+    char buf[4096];
+    size_t len = 0;
+    buf[len++] = '[';
+    for(size_t i = 0; i < size; i++) {
+      if(len + 32 > sizeof(buf)) {
+        stream_.dump(buf, len);
+        len = 0;
+      }
+      if(i > 0)
+        buf[len++] = ',';
+      len += format(vals[i], buf + len);
+    }
+    buf[len++] = ']';
+    stream_.dump(buf, len);
+    return true;
+  }
 
   /**
    * @description: 用于处理嵌套，根据输入类型 type，来进行不同的嵌套处理
@@ -236,13 +401,17 @@ private:
     if(top_depth.in_array_) { // array
       if(top_depth.value_count_ > 0) 
         stream_.dump(','); // 如果不是 array 中的第一个 element，便添加 ,
+      add_indent_aux();
     } else { // object
-      if(top_depth.value_count_ % 2 == 1) // 奇数个 object 
+      if(top_depth.value_count_ % 2 == 1) { // 奇数个 object 
         stream_.dump(':');
-      else {   
+        if(!indent_.empty())
+          stream_.dump(' ');
+      } else {   
         assert(type == TYPE_STRING && "miss quotation mark");
         if(top_depth.value_count_ > 0)
           stream_.dump(',');
+        add_indent_aux();
       }
     }
     // 如果为普通类型，则说明不会有嵌套，还是在同一 depth 之中，
@@ -250,10 +419,29 @@ private:
     top_depth.value_count_++;
   }
 
+  void check_depth_aux() const {
+    if(stack_.size() >= max_depth_)
+      throw json_exception(PARSE_DEPTH_EXCEEDED);
+  }
+
+  // 换行，并按照当前的 depth 进行缩进；indent_ 为空时什么也不做
+  void add_indent_aux() {
+    if(indent_.empty())
+      return;
+    stream_.dump('\n');
+    for(size_t i = 0; i < stack_.size(); i++)
+      stream_.dump(indent_.data(), indent_.size());
+  }
+
 private:
   std::vector<depth> stack_;
   WriteStream& stream_;
   bool see_value_;
+  std::string indent_; // 缩进的字符串，为空表示输出最紧凑的 json
+  size_t max_depth_;   // array / object 允许嵌套的最大层数
+#ifdef JSON2_ENABLE_STATS
+  stats stats_;
+#endif
 };
 
 